@@ -11,6 +11,15 @@ Toric Fano threefolds with terminal singularities, Tohoku Mathematical Journal,
 /* standard libraries */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <pthread.h>
 
 /* constants */
 #define	kTrue					1		/* handy truth values */
@@ -18,16 +27,50 @@ Toric Fano threefolds with terminal singularities, Tohoku Mathematical Journal,
 
 #define	kNoError				0		/* no error */
 #define	kMemError				1		/* not enough memory */
+#define	kFileError				2		/* unable to read or write a file */
 
 #define	kNumMin					13		/* the number of minimal polytopes */
+#define	kMinSeedVertices		4		/* the fewest and the most vertices a minimal polytope has */
+#define	kMaxSeedVertices		6
 #define	kRuleOff				"---------------------------------------------\n\n"
 
+#define	kModeSerial				0		/* classify in this process */
+#define	kModeShard				1		/* grow the polytopes of one shard and save partial results */
+#define	kModeMerge				2		/* combine the partial results */
+#define	kModeShards				3		/* run the shards as processes, then combine them */
+
+#define	kShardMagic				"PCSHARD2"	/* identifies a partial (shard) result file */
+#define	kShardName				"Polytope_Shard_%d_of_%d_%d.bin"	/* (with the number of vertices of its polytopes) */
+#define	kMaxShards				64		/* the most shards the work can be split between */
+#define	kShardPoll				10000	/* how long to wait between looks for the other shards' files (in microseconds) */
+
+#define	kStoreMagic				"PCSTORE1"	/* identifies a found list store */
+#define	kStoreVersion			2
+#define	kStorePolytope			1		/* store records: a polytope has been found */
+#define	kStoreChild				2		/* a child has been added to a polytope */
+#define	kStoreExpanded			3		/* all the children of a polytope have been found */
+#define	kMaxVertices			16		/* the most vertices a polytope can have */
+#define	kFNVOffset				14695981039346656037ULL	/* FNV-1a hash constants (the store checksum) */
+#define	kFNVPrime				1099511628211ULL
+
+#define	kBlockSize				1048576	/* the size of each block of polytope storage */
+#define	kMinBuckets				1024	/* the initial size of the found list hash table */
+#define	kMaxFacets				(2 * kMaxVertices - 4)	/* the most facets a polytope can have */
+#define	kMaxThreads				64		/* the most threads to compute the invariants with */
+#define	kInvariantsBatch		4096	/* how many polytopes' invariants to compute before writing them out */
+#define	kMaxPairs				(kMaxVertices * (kMaxVertices - 1) / 2)	/* the most pairs of vertices a polytope can have */
+#define	kReorderInterval		1024	/* how many rejections between re-ordering the pairs */
+#define	kScreenUnknown			0		/* pre-screen results: the tetrahedron must be scanned */
+#define	kScreenFree				1		/* the tetrahedron is certainly lattice-point free */
+#define	kScreenNotFree			2		/* the tetrahedron certainly contains another lattice point */
+
 /* macro functions */
 #define	MPointsEqual( pt1, pt2 )		(((pt1).x == (pt2).x) && ((pt1).y == (pt2).y) && ((pt1).z == (pt2).z))
 #define	MPointsNotEqual( pt1, pt2 )		(((pt1).x != (pt2).x) || ((pt1).y != (pt2).y) || ((pt1).z != (pt2).z))
 #define	MNormal( pt1, pt2, nor )		(nor).x = (pt1).y * (pt2).z - (pt1).z * (pt2).y; (nor).y = (pt1).z * (pt2).x - (pt1).x * (pt2).z; (nor).z = (pt1).x * (pt2).y - (pt1).y * (pt2).x
 #define	MSubtract( pt1, pt2, res )		(res).x = (pt1).x - (pt2).x; (res).y = (pt1).y - (pt2).y; (res).z = (pt1).z - (pt2).z
 #define	MDot( pt1, pt2 )				((pt1).x * (pt2).x + (pt1).y * (pt2).y + (pt1).z * (pt2).z)
+#define	MIsEven( pt )					(!((pt).x & 1) && !((pt).y & 1) && !((pt).z & 1))
 #define	MSetPoint( pt1, l1, l2, l3 )	(pt1).x = l1; (pt1).y = l2; (pt1).z = l3
 #define	MSPt( a, b, c, d, e )			MSetPoint( p[a]->vertices[b], c, d, e )
 #define	M3DTo2D( wd, ht, pt )			wd = 30.0 * (double)(pt).x + 12.0 * (double)(pt).z; ht = 30.0 * (double)(pt).y -18.0 * (double)(pt).z
@@ -45,18 +88,25 @@ typedef struct
 } BoundsRec, *BoundsPtr;
 
 typedef struct	PolyListRec	PolyListRec, *PolyListPtr, **PolyListHandle;
+typedef struct	PolytopeRec	PolytopeRec, *PolytopePtr, **PolytopeHandle;
+typedef struct	ShardPolytopeRec	ShardPolytopeRec, *ShardPolytopePtr, **ShardPolytopeHandle;
 
-typedef struct
+struct PolytopeRec
 {
 	short		numVertices,			/* the number of vertices */
 				numChildren,			/* the number of children */
-				numParents,				/* the number of parents */
-				id;						/* the polytope ID (assigned at the end) */
-	char		simplicial;				/* is the polytope simplicial? */
+				numParents;				/* the number of parents */
+	int			id;						/* the polytope ID (assigned at the end) */
+	char		simplicial,				/* is the polytope simplicial? */
+				expanded,				/* have all the children been found? */
+				frontier;				/* was it found on an earlier run, but not expanded? */
+	unsigned long long	hash;			/* the hash of the GL(3,Z) invariants */
 	Point3DPtr	vertices;				/* the list of vertices */
 	PolyListPtr	children,				/* the list of child polytopes */
 				parents;				/* the list of parent polytopes */
-} PolytopeRec, *PolytopePtr, **PolytopeHandle;
+	PolytopePtr	next;					/* the next polytope with the same hash (or the next free one) */
+	ShardPolytopePtr	shard;			/* when merging shards: the shard's copy of it */
+};
 
 struct PolyListRec
 {
@@ -64,27 +114,164 @@ struct PolyListRec
 	PolyListPtr	next;					/* the next polytope in the list */
 };
 
+typedef struct
+{
+	long			normal[3],			/* a facet: its primitive outward normal */
+					height;				/* and its height above the origin */
+	unsigned long	mask;				/* which points lie on it */
+} FacetRec, *FacetPtr;
+
+typedef struct
+{
+	int			numFacets,				/* the invariants of a polytope: the number of facets */
+				volume,					/* the normalised volume */
+				boundary,				/* the number of lattice points on the boundary */
+				interior;				/* the number of lattice points in the interior */
+	long		hStar[4];				/* the h*-vector */
+	long long	degree[2];				/* -K^3 (the normalised volume of the dual), as numerator and denominator */
+	FacetRec	facets[kMaxFacets];		/* the facets (the vertices of the dual) */
+} InvariantsRec, *InvariantsPtr;
+
+typedef struct
+{
+	PolytopeHandle	byID;				/* the work for an invariants thread: the polytopes, by ID */
+	InvariantsPtr	invariants;			/* where to put the results (for the IDs from base on) */
+	int				base,
+					first,				/* the IDs to do: first, first + step, ..., up to maxID */
+					step,
+					maxID;
+} InvariantsJobRec, *InvariantsJobPtr;
+
+typedef struct
+{
+	char		magic[8];				/* the shard file header */
+	int			shard,					/* which shard this is */
+				numShards,				/* out of how many */
+				numVertices,			/* the number of vertices of each of its polytopes */
+				numPolys;				/* the number of polytopes in the file */
+} ShardHeaderRec;
+
+typedef struct
+{
+	int			shard,					/* where a child in a shard came from: the shard of its parent, */
+				index,					/* the parent's place in that shard's file, */
+				known;					/* and which of the parent's new vertices it was */
+	PolytopePtr	p;						/* the child */
+} ShardSourceRec, *ShardSourcePtr;
+
+typedef struct
+{
+	Point3DRec			vertex;			/* the new vertex of a child of a polytope read from a shard file */
+	ShardPolytopePtr	child;			/* and the child */
+} ShardKnownRec, *ShardKnownPtr;
+
+struct ShardPolytopeRec
+{
+	unsigned long long	hash;			/* a polytope read from a shard file: the hash of its invariants */
+	short		numVertices;			/* the number of vertices */
+	int			numKnown;				/* the number of new vertices of its children */
+	Point3DPtr	vertices;				/* the vertices */
+	ShardKnownPtr	known;				/* the new vertices (sorted, once they've been carried over to the found
+										   polytope's coordinates) */
+	PolytopePtr	found;					/* the polytope on the found list it turned out to be (if any yet) */
+};
+
+typedef struct
+{
+	char				magic[8];		/* the store file header */
+	int					version,		/* the store format */
+						recordSize;		/* the size of each record */
+	long long			numRecords;		/* the number of records committed */
+	unsigned long long	checksum;		/* the FNV-1a hash of the committed records */
+	char				pad[32];		/* (pad the header to 64 bytes) */
+} StoreHeaderRec;
+
+typedef struct
+{
+	short		type,					/* what is being recorded */
+				numVertices;			/* the number of vertices (polytope records only) */
+	int			index,					/* the polytope, by order found (counting from 0) */
+				child;					/* the child, by order found (child records only) */
+	Point3DRec	vertices[kMaxVertices];	/* the vertices (polytope records only) */
+} StoreRecordRec, *StoreRecordPtr;
+
 /* global variables */
-PolyListPtr		gPolyList;				/* the list of found polytopes */
+PolyListPtr		gPolyList,				/* the list of found polytopes */
+				gPolyListEnd;			/* the last entry in the list */
+PolytopeHandle	gBuckets;				/* the found polytopes, hashed by their invariants */
+long			gNumBuckets,			/* the size of the hash table */
+				gNumFound;				/* the number of polytopes in it */
+PolytopePtr		gFreePolytopes[kMaxVertices + 1];	/* disposed of polytopes, by number of vertices */
+char			*gBlock;				/* the current block of polytope storage */
+size_t			gBlockUsed;				/* how much of it has been used */
+int				gStoreFile = -1;		/* the found list store (if any) */
+StoreHeaderRec	gStoreHeader;			/* the store header, as last committed */
+char			gFixedOrder = kFalse;	/* test the tetrahedra in index order, without the pre-screen? */
+char			gSharding = kFalse;		/* growing a shard (recording the new vertices of the children, not the children)? */
+Point3DPtr		gKnown;					/* those new vertices, for the polytope being grown */
+int				gNumKnown,				/* how many there are */
+				gMaxKnown;				/* and how many there's room for */
+ShardSourcePtr	gSources;				/* where the children that belong to the shard came from */
+long			gNumSources,			/* how many there are */
+				gMaxSources;			/* and how many there's room for */
+ShardPolytopeHandle	gShardPolys;		/* when merging shards, the polytopes they grew (in the order read) */
+long			gNumShardPolys;			/* and how many there are */
+short			gPairOrder[kMaxPairs];	/* the order to test the pairs of vertices in (as i * kMaxVertices + j) */
+long			gPairRejects[kMaxVertices * kMaxVertices],	/* how many candidates each pair has rejected */
+				gNumCandidates,			/* the number of candidate children tested */
+				gNumRejected,			/* the number of them rejected */
+				gNumEvaluated,			/* the number of tetrahedra evaluated for the rejected candidates */
+				gNumScanned,			/* how many of those needed a full scan */
+				gNumScreened;			/* the number of candidates rejected without any full scan */
 
 /* function prototypes */
-int					main						( void );
+int					main						( int, char ** );
 static void			doAppInit					( void );
 static char			doClassifyPolytopes			( void );
+static char			doRunShards					( short );
+static char			doGrowShard					( short, short );
+static char			doReadShards				( short, short, short, char, char * );
+static char			doSaveShard					( short, short, short );
+static char			doIsShardComplete			( short, short, short );
+static char			doMergeShards				( short );
+static char			doReadShardPolytope			( FILE *, short, short, short, long *, int *, char * );
+static char			doFindKnownVertices			( PolytopePtr );
+static ShardPolytopePtr	doFindShardPolytope		( PolytopePtr );
+static PolytopePtr	doIsNewShardPolytope		( PolytopePtr, Point3DPtr, PolytopePtr, char * );
+static int			doCompareSources			( const void *, const void * );
+static int			doComparePoints				( const void *, const void * );
+static char			doAddKnownVertex			( Point3DPtr );
+static char			doReserveKnown				( int );
+static char			doOpenStore					( char * );
+static char			doLoadStore					( StoreRecordPtr, long long );
+static char			doAppendToStore				( short, PolytopePtr, PolytopePtr );
+static void			doCloseStore				( void );
+static unsigned long long	doChecksum			( unsigned long long, void *, size_t );
 static void			doDisposePolytopeList		( void );
 static char			doCreateMinimalPolytopes	( PolytopeHandle );
 static char			doAddPolytopeToList			( PolytopePtr );
 static PolytopePtr	doNewPolytope				( short );
-static PolytopePtr	doNewPolytopeChild			( PolytopePtr );
+static PolytopePtr	doCopyPolytope				( PolytopePtr );
+static void *		doAllocate					( size_t );
+static unsigned long long	doHashPolytope		( PolytopePtr );
+static char			doAddPolytopeToTable		( PolytopePtr );
 static void			doDisposePolytope			( PolytopePtr );
 static char			doIsSimplicial				( PolytopePtr );
 static char			doAreCoplanar				( Point3DPtr, Point3DPtr, Point3DPtr, Point3DPtr );
 static char			doIsFace					( PolytopePtr, Point3DPtr, Point3DPtr, Point3DPtr );
 static char			doIsEdge					( PolytopePtr, Point3DPtr, Point3DPtr );
 static char			doIsFreeTetrahedron			( Point3DPtr, Point3DPtr, Point3DPtr );
+static ShardKnownPtr	doFindKnownVertex		( PolytopePtr, Point3DPtr );
 static void			doAddPointToBoundingBox		( BoundsPtr, Point3DPtr );
 static char			doIsInternal				( Point3DPtr, Point3DPtr, Point3DPtr, Point3DPtr );
 static char			doIsChildFano				( PolytopePtr, Point3DPtr );
+static char			doIsChildTerminal			( PolytopePtr, Point3DPtr );
+static short		doFindFacets				( Point3DPtr, short, FacetPtr );
+static char			doScreenTetrahedron			( Point3DPtr, Point3DPtr, Point3DPtr );
+static long			doFindHCF					( long, long );
+static void			doReorderPairs				( void );
+static int			doComparePairs				( const void *, const void * );
+static void			doReportRejections			( void );
 static char			doEnlargePolytope			( PolytopePtr );
 static char			doAddOverVertex				( PolytopePtr );
 static char			doAddOverEdge				( PolytopePtr );
@@ -93,27 +280,115 @@ static char			doFindNewVertex				( PolytopePtr, Point3DPtr, Point3DPtr, Point3DP
 static char			doCheckBarrycentric			( PolytopePtr, short, short, short, short, Point3DPtr, Point3DPtr, Point3DPtr );
 static char			doCheckBarrycentricPerm		( PolytopePtr, short, short, short, short, Point3DPtr, Point3DPtr, Point3DPtr );
 static char			doUpdateList				( PolytopePtr, PolyListHandle );
-static void			doAddChildToList			( PolytopePtr, PolytopePtr );
+static char			doAddChildToList			( PolytopePtr, PolytopePtr );
 static PolytopePtr	doIsNewPolytope				( PolytopePtr, char * );
 static char			doArePolytopesSimilar		( PolytopePtr, PolytopePtr );
 static char			doRotatePolytope			( PolytopePtr, PolytopePtr, PolytopePtr, short, short, short );
 static char			doArePolytopesSame			( PolytopePtr, PolytopePtr );
 static void			doAssignIDs					( void );
 static void			doSaveResults				( void );
+static void			doSaveInvariants			( PolytopeHandle, int );
+static void *		doInvariantsThread			( void * );
+static void			doCalculateInvariants		( PolytopePtr, InvariantsPtr );
+static void			doCountLatticePoints		( PolytopePtr, FacetPtr, int, int, long *, long * );
+static void			doAddFraction				( long long *, long long, long long );
 static void			doWriteVertices				( PolytopePtr, FILE * );
 static void			doWriteList					( PolyListPtr, FILE * );
+static int			doCompareIDOrder			( const void *, const void * );
+static int			doCompareIDs				( const void *, const void * );
 
 /* main -	the program entry/exit point */
-int main( void )
+/*	With no arguments the whole classification is run in this process, and the results are saved to Polytope_Data.txt
+	(with the volume, lattice point counts, h*-vector, dual and -K^3 of each polytope in Polytope_Invariants.txt). Otherwise:
+		-shard i n		grow only the polytopes of the i-th of n shards (those whose invariants hash to i mod n), a
+						number of vertices at a time, writing a partial result file for each (the shards must all
+						be run, at once, since each waits for the others' files before going on to the next number)
+		-merge n		combine the n shards' partial result files and save the results
+		-shards n		run the n shards as local processes (picking up where any earlier run left off), then merge them
+		-store file		keep the found list in the given file, extending whatever it already holds
+		-fixedorder		test the tetrahedra in index order without the pre-screen (to compare the rejection statistics)	*/
+int main( int argc, char **argv )
 {	
+	char		err, mode = kModeSerial, *store = kFalse;
+	short		shard = 0, numShards = 1, i;
+	
 	/* initialize the application */
 	doAppInit();
-		
+	
+	/* read the command line */
+	for( i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-shard" ) && (i + 2 < argc) )
+		{
+			mode = kModeShard;
+			shard = atoi( argv[++i] );
+			numShards = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-merge" ) && (i + 1 < argc) )
+		{
+			mode = kModeMerge;
+			numShards = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-shards" ) && (i + 1 < argc) )
+		{
+			mode = kModeShards;
+			numShards = atoi( argv[++i] );
+		}
+		else if( !strcmp( argv[i], "-store" ) && (i + 1 < argc) )
+			store = argv[++i];
+		else if( !strcmp( argv[i], "-fixedorder" ) )
+			gFixedOrder = kTrue;
+		else
+		{
+			printf( "Usage: %s [-shard i n | -merge n | -shards n] [-store file] [-fixedorder]\n", argv[0] );
+			return( 1 );
+		}
+	}
+	if( (numShards < 1) || (numShards > kMaxShards) || (shard < 0) || (shard >= numShards) )
+	{
+		printf( "The number of shards must be between 1 and %d!\n", kMaxShards );
+		return( 1 );
+	}
+	if( store && (mode != kModeSerial) )
+	{
+		printf( "A store can only be used when classifying in a single process!\n" );
+		return( 1 );
+	}
+	
+	/* load anything we found on a previous run */
+	if( store && ((err = doOpenStore( store )) != kNoError) )
+	{
+		printf( "Calculation aborted!!!\n" );
+		return( err );
+	}
+	
 	/* generate the polytope list */
-	if( doClassifyPolytopes() == kNoError )
+	switch( mode )
 	{
-		/* save the results */
-		doSaveResults();
+		case kModeSerial:
+			if( (err = doClassifyPolytopes()) == kNoError )
+				doAssignIDs();
+			break;
+		case kModeShard:
+			err = doGrowShard( shard, numShards );
+			break;
+		default:
+			if( (err = doRunShards( (mode == kModeShards) ? numShards : 0 )) == kNoError )
+				err = doMergeShards( numShards );
+			break;
+	}
+	if( store )
+		doCloseStore();
+	
+	if( err == kNoError )
+	{
+		/* say how quickly the candidates were rejected */
+		if( (mode != kModeMerge) && (mode != kModeShards) )
+			doReportRejections();
+		
+		/* save the results (a shard's results are only partial) */
+		if( mode != kModeShard )
+			doSaveResults();
 		
 		/* finally dispose of the polytope list */
 		doDisposePolytopeList();
@@ -123,23 +398,33 @@ int main( void )
 		
 	/* finished */
 	printf( "\n%sFinished.\n", kRuleOff );
+	
+	return( err );
 }
 
 
 /* doAppInit -	call to initialize the application */
 static void doAppInit( void )
 {	
+	short		i, j, k = 0;
+	
 	printf( "%sProgrammed by Alexander M Kasprzyk, May 2003.\n", kRuleOff );
 	printf( "\thttp://www.math.unb.ca/~kasprzyk/\n\n%s", kRuleOff );
 	printf( "Classification can take up to 30 minutes.\n\n%s", kRuleOff );
 	
-	gPolyList = kFalse;
+	gPolyList = gPolyListEnd = kFalse;
+	
+	/* start by testing the pairs of vertices in index order */
+	for( i = 0; i < kMaxVertices; i++ )
+		for( j = i + 1; j < kMaxVertices; j++ )
+			gPairOrder[k++] = i * kMaxVertices + j;
 }
 
 /* doClassifyPolytopes -	call to classify the polytopes */
 static char doClassifyPolytopes( void )
 {
 	PolytopePtr	p[kNumMin];
+	PolyListPtr	list;
 	char		err;
 	short		i;
 	
@@ -147,38 +432,866 @@ static char doClassifyPolytopes( void )
 	if( err = doCreateMinimalPolytopes( p ) )
 		return( err );
 	
-	/* grow from each seed in turn */
+	/* grow from each seed in turn (unless an earlier run has already done so) */
 	for( i = 0; i < kNumMin; i++ )
+		if( !p[i]->expanded )
+		{
+			printf( "Growing Minimal Polytope %d of %d...\n", i + 1, kNumMin );
+			if( (err = doEnlargePolytope( p[i] )) )
+				return( err );
+		}
+	
+	/* finally, grow anything an earlier run found but never reached */
+	for( list = gPolyList; list; list = list->next )
+		if( list->p->frontier )
+		{
+			list->p->frontier = kFalse;
+			if( (err = doEnlargePolytope( list->p )) )
+				return( err );
+		}
+	
+	return( kNoError );
+}
+
+/* doRunShards -	call to run each shard in its own process, waiting for them all to finish */
+/*	The shards wait for each other's files, so as soon as one fails the rest are stopped. A shard picks up from the
+	files it has already written, so the run can simply be started again.										*/
+static char doRunShards( short numShards )
+{
+	short		i, j, numRunning = 0;
+	char		err = kNoError;
+	pid_t		*pids, pid;
+	int			status;
+	
+	if( !numShards )
+		return( kNoError );
+	if( !(pids = (pid_t *)calloc( numShards, sizeof( pid_t ) )) )
+		return( kMemError );
+	
+	/* start the shards */
+	fflush( stdout );
+	for( i = 0; (i < numShards) && (err == kNoError); i++ )
 	{
-		printf( "Growing Minimal Polytope %d of %d...\n", i + 1, kNumMin );
-		if( err = doEnlargePolytope( p[i] ) )
-			return( err );
+		if( (pids[i] = fork()) < 0 )
+		{
+			printf( "Unable to start shard %d of %d!!!\n", i + 1, numShards );
+			pids[i] = 0;
+			err = kMemError;
+		}
+		else if( !pids[i] )
+		{	/* we're the child: grow our shard */
+			err = doGrowShard( i, numShards );
+			fflush( stdout );
+			_exit( err );
+		}
+		else
+			numRunning++;
+	}
+	
+	/* wait for them to finish */
+	while( numRunning )
+	{
+		if( err != kNoError )
+			for( j = 0; j < numShards; j++ )
+				if( pids[j] > 0 )	kill( pids[j], SIGTERM );
+		if( (pid = wait( &status )) < 0 )
+			break;
+		for( i = 0; (i < numShards) && (pids[i] != pid); i++ )
+			;
+		if( i == numShards )
+			continue;
+		pids[i] = 0;
+		numRunning--;
+		if( (!WIFEXITED( status ) || WEXITSTATUS( status )) && (err == kNoError) )
+		{
+			printf( "Shard %d of %d failed!!!\n", i + 1, numShards );
+			err = kFileError;
+		}
+	}
+	
+	free( (void *)pids );
+	
+	return( err );
+}
+
+/* doGrowShard -	call to grow the polytopes of the given shard, a number of vertices at a time */
+/*	A polytope belongs to the shard picked out by the hash of its GL(3,Z) invariants, so each polytope belongs to
+	exactly one shard, and is grown only once. Growing it here means finding the new vertices of its children,
+	which are written to the shard's file for its number of vertices; the shard's polytopes with one more vertex
+	are then its seeds with that many vertices, and the children (from every shard's file) that belong to it.
+	A file that is already complete isn't written again, so a shard that failed can be restarted. We stop once
+	there are no seeds to come and no shard found any children.												*/
+static char doGrowShard( short shard, short numShards )
+{
+	PolytopePtr	seeds[kNumMin];
+	char		err = kNoError, more = kTrue, complete;
+	short		v;
+	
+	for( v = kMinSeedVertices; more && (err == kNoError); v++ )
+	{
+		/* find our polytopes with v vertices (unless we've already grown them) */
+		complete = doIsShardComplete( shard, numShards, v );
+		more = (v <= kMaxSeedVertices);
+		if( ((err = doCreateMinimalPolytopes( seeds )) == kNoError) && (v > kMinSeedVertices) )
+			err = doReadShards( shard, numShards, v - 1, !complete, &more );
+		
+		/* and grow them */
+		if( (err == kNoError) && more && !complete )
+		{
+			printf( "Growing the polytopes with %d vertices in shard %d of %d...\n", v, shard + 1, numShards );
+			fflush( stdout );
+			err = doSaveShard( shard, numShards, v );
+		}
+		doDisposePolytopeList();
+	}
+	if( gSources )
+		free( (void *)gSources );
+	gSources = kFalse;
+	gNumSources = gMaxSources = 0;
+	
+	return( err );
+}
+
+/* doReadShards -	call to read every shard's file for the given number of vertices, adding the children that belong to
+					the given shard to the found list (if asked to) */
+/*	Each file is waited for if need be, and more is set if any of the polytopes in them have children. Where each
+	child came from is kept in gSources, for doSaveShard.													*/
+static char doReadShards( short shard, short numShards, short numVertices, char collect, char *more )
+{
+	char		err = kNoError;
+	short		s;
+	
+	gNumSources = 0;
+	for( s = 0; (s < numShards) && (err == kNoError); s++ )
+	{
+		char			name[64];
+		FILE			*file;
+		ShardHeaderRec	header;
+		int				t, polls = 0;
+		
+		/* wait for the shard to finish its file (saying so, if it's taking a while) */
+		sprintf( name, kShardName, s, numShards, numVertices );
+		while( !doIsShardComplete( s, numShards, numVertices ) )
+		{
+			if( ++polls == 1000000 / kShardPoll )
+			{
+				printf( "Shard %d of %d is waiting for shard %d to grow its polytopes with %d vertices...\n", shard + 1,
+					numShards, s + 1, numVertices );
+				fflush( stdout );
+			}
+			usleep( kShardPoll );
+		}
+		if( !(file = fopen( name, "rb" )) || (fread( &header, sizeof( header ), 1, file ) != 1) )
+		{
+			printf( "Unable to read the shard file '%s'!!!\n", name );
+			if( file )	fclose( file );
+			return( kFileError );
+		}
+		
+		/* read the polytopes, keeping the children that belong to us */
+		for( t = 0; (t < header.numPolys) && (err == kNoError); t++ )
+		{
+			PolytopeRec	q;
+			Point3DRec	vertices[kMaxVertices + 1];
+			int			numKnown, numSources, i;
+			
+			if( (fread( &numKnown, sizeof( int ), 1, file ) != 1) || (fread( &numSources, sizeof( int ), 1, file ) != 1)
+				|| (numKnown < 0) || (numSources < 0) || (numKnown && (numVertices >= kMaxVertices))
+				|| (fread( vertices, sizeof( Point3DRec ), numVertices, file ) != (size_t)numVertices) )
+				err = kFileError;
+			else if( (err = doReserveKnown( numKnown )) == kNoError )
+			{
+				if( (fread( gKnown, sizeof( Point3DRec ), numKnown, file ) != (size_t)numKnown)
+					|| fseek( file, (long)sizeof( int ) * 3 * numSources, SEEK_CUR ) )
+					err = kFileError;
+				if( numKnown )
+					*more = kTrue;
+			}
+			q.numVertices = numVertices + 1;
+			q.vertices = vertices;
+			for( i = 0; collect && (i < numKnown) && (err == kNoError); i++ )
+			{
+				PolytopePtr	child;
+				char		wasNew;
+				
+				vertices[numVertices] = gKnown[i];
+				if( doHashPolytope( &q ) % numShards != (unsigned long long)shard )
+					continue;
+				if( !(child = doIsNewPolytope( &q, &wasNew )) )
+				{
+					err = kMemError;
+					break;
+				}
+				if( gNumSources == gMaxSources )
+				{
+					ShardSourcePtr	sources;
+					long			max = gMaxSources ? 2 * gMaxSources : kMinBuckets;
+					
+					if( !(sources = (ShardSourcePtr)realloc( (void *)gSources, sizeof( ShardSourceRec ) * max )) )
+					{
+						printf( "\nNot enough memory for the children!!!\n\n" );
+						err = kMemError;
+						break;
+					}
+					gSources = sources;
+					gMaxSources = max;
+				}
+				gSources[gNumSources].shard = s;
+				gSources[gNumSources].index = t;
+				gSources[gNumSources].known = i;
+				gSources[gNumSources++].p = child;
+			}
+		}
+		fclose( file );
+		if( err == kFileError )
+			printf( "The shard file '%s' is damaged!!!\n", name );
+	}
+	
+	return( err );
+}
+
+/* doSaveShard -	call to grow the shard's polytopes with the given number of vertices, writing them to a partial result file */
+/*	The file is the header, then for each polytope: the number of new vertices of its children, the number of places
+	it came from, its vertices, the new vertices (in its coordinates), and the places it came from (as in
+	ShardSourceRec). It ends with the magic number again, to show that it's complete.							*/
+static char doSaveShard( short shard, short numShards, short numVertices )
+{
+	char			name[64], temp[72], err = kNoError;
+	FILE			*file;
+	ShardHeaderRec	header;
+	PolyListPtr		list;
+	ShardSourcePtr	source = gSources, end = gSources + gNumSources;
+	
+	/* write to a temporary file first, so that an interrupted shard never leaves a partial file behind */
+	sprintf( name, kShardName, shard, numShards, numVertices );
+	sprintf( temp, "%s.tmp", name );
+	if( !(file = fopen( temp, "wb" )) )
+	{
+		printf( "Unable to create the shard file '%s'!!!\n", temp );
+		return( kFileError );
+	}
+	
+	/* the header (numbering the polytopes in the order they're written, which is how the next shards refer to them) */
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, kShardMagic, sizeof( header.magic ) );
+	header.shard = shard;
+	header.numShards = numShards;
+	header.numVertices = numVertices;
+	for( list = gPolyList; list; list = list->next )
+		if( (list->p->numVertices == numVertices) && (list->p->hash % numShards == (unsigned long long)shard) )
+			list->p->id = header.numPolys++;
+	fwrite( &header, sizeof( header ), 1, file );
+	if( gNumSources )
+		qsort( (void *)gSources, gNumSources, sizeof( ShardSourceRec ), doCompareSources );
+	
+	/* grow the polytopes, recording the new vertices rather than adding the children */
+	gSharding = kTrue;
+	for( list = gPolyList; list && (err == kNoError); list = list->next )
+		if( (list->p->numVertices == numVertices) && (list->p->hash % numShards == (unsigned long long)shard) )
+		{
+			int			numSources = 0, data[3];
+			
+			gNumKnown = 0;
+			if( (err = doEnlargePolytope( list->p )) == kNoError )
+			{
+				while( (source + numSources < end) && (source[numSources].p == list->p) )
+					numSources++;
+				fwrite( &gNumKnown, sizeof( int ), 1, file );
+				fwrite( &numSources, sizeof( int ), 1, file );
+				fwrite( list->p->vertices, sizeof( Point3DRec ), numVertices, file );
+				if( gNumKnown )
+					fwrite( gKnown, sizeof( Point3DRec ), gNumKnown, file );
+				for( ; numSources--; source++ )
+				{
+					data[0] = source->shard;
+					data[1] = source->index;
+					data[2] = source->known;
+					fwrite( data, sizeof( int ), 3, file );
+				}
+			}
+		}
+	gSharding = kFalse;
+	
+	/* close the file and move it into place */
+	if( err == kNoError )
+		fwrite( kShardMagic, sizeof( header.magic ), 1, file );
+	if( (fclose( file ) || rename( temp, name )) && (err == kNoError) )
+	{
+		printf( "Unable to write the shard file '%s'!!!\n", name );
+		err = kFileError;
+	}
+	
+	return( err );
+}
+
+/* doIsShardComplete -	call to check whether the given shard has written a complete result file for the given number of vertices */
+static char doIsShardComplete( short shard, short numShards, short numVertices )
+{
+	char			name[64], trailer[8];
+	FILE			*file;
+	ShardHeaderRec	header;
+	char			complete = kFalse;
+	
+	sprintf( name, kShardName, shard, numShards, numVertices );
+	if( (file = fopen( name, "rb" )) )
+	{
+		if( (fread( &header, sizeof( header ), 1, file ) == 1) && !memcmp( header.magic, kShardMagic, sizeof( header.magic ) )
+			&& (header.shard == shard) && (header.numShards == numShards) && (header.numVertices == numVertices)
+			&& !fseek( file, -(long)sizeof( trailer ), SEEK_END ) && (fread( trailer, sizeof( trailer ), 1, file ) == 1)
+			&& !memcmp( trailer, kShardMagic, sizeof( trailer ) ) )
+			complete = kTrue;
+		fclose( file );
+	}
+	
+	return( complete );
+}
+
+/* doMergeShards -	call to combine the shard files into the found list, in the order a single process would have found them */
+/*	Between them the shards have found the new vertices of the children of every polytope, and which polytope each
+	one gives, so we run the search just as a single process would, but look the children up rather than checking
+	the tetrahedra and comparing the polytopes. The checks don't depend on the coordinates, so a shard's new vertices
+	carry over to the coordinates the search has the polytope in (see doFindKnownVertices), and the found list, and
+	so the IDs assigned by doAssignIDs, come out the same.														*/
+static char doMergeShards( short numShards )
+{
+	long		first[kMaxVertices + 2][kMaxShards], maxShardPolys = 0, i;
+	int			numPolys[kMaxVertices + 2][kMaxShards], k;
+	char		err = kNoError, more = kTrue;
+	short		v, s;
+	
+	/* read the shards' polytopes, a number of vertices at a time, stopping where the shards did */
+	printf( "Merging %d shards...\n", numShards );
+	memset( (void *)numPolys, 0, sizeof( numPolys ) );
+	for( v = kMinSeedVertices; more && (err == kNoError); v++ )
+		for( more = (v < kMaxSeedVertices), s = 0; (s < numShards) && (err == kNoError); s++ )
+		{
+			char			name[64];
+			FILE			*file;
+			ShardHeaderRec	header;
+			int				t;
+			
+			sprintf( name, kShardName, s, numShards, v );
+			if( !doIsShardComplete( s, numShards, v ) || !(file = fopen( name, "rb" )) )
+			{
+				printf( "The shard file '%s' is missing or incomplete!!!\n", name );
+				err = kFileError;
+				break;
+			}
+			if( (fread( &header, sizeof( header ), 1, file ) != 1) || (header.numPolys < 0) )
+				err = kFileError;
+			else if( gNumShardPolys + header.numPolys > maxShardPolys )
+			{
+				ShardPolytopeHandle		polys;
+				
+				while( gNumShardPolys + header.numPolys > maxShardPolys )
+					maxShardPolys = maxShardPolys ? 2 * maxShardPolys : kMinBuckets;
+				if( !(polys = (ShardPolytopeHandle)realloc( (void *)gShardPolys, sizeof( ShardPolytopePtr ) * maxShardPolys )) )
+				{
+					printf( "\nNot enough memory for the shards' polytopes!!!\n\n" );
+					err = kMemError;
+				}
+				else
+					gShardPolys = polys;
+			}
+			first[v][s] = gNumShardPolys;
+			numPolys[v][s] = header.numPolys;
+			for( t = 0; (t < header.numPolys) && (err == kNoError); t++ )
+				err = doReadShardPolytope( file, s, v, numShards, first[v - 1], numPolys[v - 1], &more );
+			fclose( file );
+			if( err == kFileError )
+				printf( "The shard file '%s' is damaged!!!\n", name );
+		}
+	
+	/* every new vertex should have given a child */
+	for( i = 0; (i < gNumShardPolys) && (err == kNoError); i++ )
+		for( k = 0; (k < gShardPolys[i]->numKnown) && (err == kNoError); k++ )
+			if( !gShardPolys[i]->known[k].child )
+			{
+				printf( "A child is missing from the shard files!!!\n" );
+				err = kFileError;
+			}
+	
+	/* then run the search, and assign the polytope ID's */
+	if( err == kNoError )
+		if( (err = doClassifyPolytopes()) == kNoError )
+			doAssignIDs();
+	if( gShardPolys )
+		free( (void *)gShardPolys );
+	gShardPolys = kFalse;
+	gNumShardPolys = 0;
+	
+	return( err );
+}
+
+/* doReadShardPolytope -	call to read a polytope from a shard file, linking it to those (with one fewer vertex) it came from */
+/*	first and numPolys say where the polytopes of each shard's file with one fewer vertex are in gShardPolys.	*/
+static char doReadShardPolytope( FILE *file, short shard, short numVertices, short numShards, long *first, int *numPolys, char *more )
+{
+	ShardPolytopePtr	p;
+	PolytopeRec			q;
+	int					numKnown, numSources, data[3], i;
+	
+	/* read the polytope and its new vertices */
+	if( (fread( &numKnown, sizeof( int ), 1, file ) != 1) || (fread( &numSources, sizeof( int ), 1, file ) != 1)
+		|| (numKnown < 0) || (numSources < 0) || (numKnown && (numVertices >= kMaxVertices)) )
+		return( kFileError );
+	if( !(p = (ShardPolytopePtr)doAllocate( sizeof( ShardPolytopeRec ) + sizeof( ShardKnownRec ) * numKnown
+		+ sizeof( Point3DRec ) * numVertices )) )
+	{
+		printf( "\nNot enough memory for the shards' polytopes!!!\n\n" );
+		return( kMemError );
+	}
+	p->numVertices = numVertices;
+	p->numKnown = numKnown;
+	p->known = (ShardKnownPtr)(p + 1);
+	p->vertices = (Point3DPtr)(p->known + numKnown);
+	p->found = kFalse;
+	if( fread( p->vertices, sizeof( Point3DRec ), numVertices, file ) != (size_t)numVertices )
+		return( kFileError );
+	for( i = 0; i < numKnown; i++ )
+	{
+		if( fread( &p->known[i].vertex, sizeof( Point3DRec ), 1, file ) != 1 )
+			return( kFileError );
+		p->known[i].child = kFalse;
+	}
+	if( numKnown )
+		*more = kTrue;
+	
+	/* check that it belongs to the shard */
+	q.numVertices = numVertices;
+	q.vertices = p->vertices;
+	if( (p->hash = doHashPolytope( &q )) % numShards != (unsigned long long)shard )
+		return( kFileError );
+	
+	/* and link it to where it came from */
+	for( i = 0; i < numSources; i++ )
+	{
+		ShardPolytopePtr	parent;
+		
+		if( (fread( data, sizeof( int ), 3, file ) != 3) || (data[0] < 0) || (data[0] >= numShards) || (data[1] < 0)
+			|| (data[1] >= numPolys[data[0]]) || (data[2] < 0)
+			|| (data[2] >= (parent = gShardPolys[first[data[0]] + data[1]])->numKnown) )
+			return( kFileError );
+		parent->known[data[2]].child = p;
 	}
+	gShardPolys[gNumShardPolys++] = p;
+	
+	return( kNoError );
+}
+
+/* doFindKnownVertices -	call to carry the new vertices the shard found for the children of p over to p's coordinates */
+/*	The shard's copy of p is the same up to GL(3,Z), so we find a transformation taking it to p (as in
+	doArePolytopesSimilar), and apply that to the new vertices too. Each polytope is only grown once, so the
+	shard's copy can be overwritten.																			*/
+static char doFindKnownVertices( PolytopePtr p )
+{
+	ShardPolytopePtr	s;
+	PolytopeRec			from, to;
+	Point3DPtr			points;
+	short				i, j, k;
+	int					l, n;
+	
+	/* find the shard's copy (the seeds aren't found through doIsNewShardPolytope) */
+	if( !p->shard && !(p->shard = doFindShardPolytope( p )) )
+		return( kFileError );
+	s = p->shard;
+	s->found = p;
+	
+	/* collect its vertices and then the new vertices */
+	n = s->numVertices + s->numKnown;
+	if( !(points = (Point3DPtr)malloc( sizeof( Point3DRec ) * 2 * n )) )
+	{
+		printf( "\nNot enough memory for the new vertices!!!\n\n" );
+		return( kMemError );
+	}
+	memcpy( (void *)points, (void *)s->vertices, sizeof( Point3DRec ) * s->numVertices );
+	for( l = 0; l < s->numKnown; l++ )
+		points[s->numVertices + l] = s->known[l].vertex;
+	
+	/* find the transformation, trying it on the vertices alone */
+	from.numVertices = s->numVertices;
+	from.vertices = points;
+	to.numVertices = p->numVertices;
+	to.vertices = points + n;
+	memcpy( (void *)to.vertices, (void *)points, sizeof( Point3DRec ) * n );
+	for( i = 0; i < p->numVertices; i++ )
+		for( j = 0; j < p->numVertices; j++ )
+			if( i != j )
+				for( k = 0; k < p->numVertices; k++ )
+					if( (i != k) && (j != k) && doRotatePolytope( &to, &from, p, i, j, k ) && doArePolytopesSame( &to, p ) )
+					{
+						/* and then on everything, sorting the new vertices for doFindKnownVertex */
+						from.numVertices = n;
+						doRotatePolytope( &to, &from, p, i, j, k );
+						memcpy( (void *)s->vertices, (void *)to.vertices, sizeof( Point3DRec ) * s->numVertices );
+						for( l = 0; l < s->numKnown; l++ )
+							s->known[l].vertex = to.vertices[s->numVertices + l];
+						qsort( (void *)s->known, s->numKnown, sizeof( ShardKnownRec ), doComparePoints );
+						free( (void *)points );
+						return( kNoError );
+					}
+	free( (void *)points );
+	
+	printf( "\nA polytope doesn't match the shards' copy of it!!!\n\n" );
+	return( kFileError );
+}
+
+/* doFindShardPolytope -	call to find the shards' copy of the given polytope (for the seeds: the rest are found through
+							their parents) */
+static ShardPolytopePtr doFindShardPolytope( PolytopePtr p )
+{
+	unsigned long long	hash = doHashPolytope( p );
+	long				i;
+	
+	for( i = 0; i < gNumShardPolys; i++ )
+		if( (gShardPolys[i]->hash == hash) && (gShardPolys[i]->numVertices == p->numVertices) )
+		{
+			PolytopeRec		q;
+			
+			q.numVertices = gShardPolys[i]->numVertices;
+			q.vertices = gShardPolys[i]->vertices;
+			if( doArePolytopesSimilar( p, &q ) )
+				return( gShardPolys[i] );
+		}
+	
+	printf( "\nA polytope is missing from the shard files!!!\n\n" );
+	return( kFalse );
+}
+
+/* doIsNewShardPolytope -	call to find the child p of parent (with the given new vertex) on the found list when merging
+							shards, adding it if it's new (as doIsNewPolytope) */
+static PolytopePtr doIsNewShardPolytope( PolytopePtr parent, Point3DPtr newVertex, PolytopePtr p, char *wasNew )
+{
+	ShardPolytopePtr	s = doFindKnownVertex( parent, newVertex )->child;
+	PolytopePtr			q;
+	
+	/* it's already been found */
+	*wasNew = kFalse;
+	if( s->found )
+		return( s->found );
+	
+	/* the polytope must be new; add a copy of it to the list */
+	*wasNew = kTrue;
+	if( !(q = doCopyPolytope( p )) )
+		return( kFalse );
+	if( doAddPolytopeToList( q ) != kNoError )
+		return( kFalse );
+	q->shard = s;
+	s->found = q;
+	
+	return( q );
+}
+
+/* doCompareSources -	call to order the sources of the children by child (in the order they're written), then by source */
+static int doCompareSources( const void *a, const void *b )
+{
+	ShardSourcePtr	s = (ShardSourcePtr)a, t = (ShardSourcePtr)b;
+	
+	if( s->p->id != t->p->id )		return( (s->p->id > t->p->id) - (s->p->id < t->p->id) );
+	if( s->shard != t->shard )		return( (s->shard > t->shard) - (s->shard < t->shard) );
+	if( s->index != t->index )		return( (s->index > t->index) - (s->index < t->index) );
+	
+	return( (s->known > t->known) - (s->known < t->known) );
+}
+
+/* doComparePoints -	call to compare two points (for sorting) */
+static int doComparePoints( const void *a, const void *b )
+{
+	Point3DPtr	p = (Point3DPtr)a, q = (Point3DPtr)b;
+	
+	if( p->x != q->x )	return( (p->x > q->x) - (p->x < q->x) );
+	if( p->y != q->y )	return( (p->y > q->y) - (p->y < q->y) );
+	
+	return( (p->z > q->z) - (p->z < q->z) );
+}
+
+/* doAddKnownVertex -	call to record the new vertex of a child of the polytope the shard is growing (once) */
+static char doAddKnownVertex( Point3DPtr newVertex )
+{
+	char		err;
+	int			i;
 	
-	/* assign the polytope ID's */
-	doAssignIDs();
+	for( i = 0; i < gNumKnown; i++ )
+		if( MPointsEqual( gKnown[i], *newVertex ) )
+			return( kNoError );
+	if( (err = doReserveKnown( gNumKnown + 1 )) != kNoError )
+		return( err );
+	gKnown[gNumKnown++] = *newVertex;
+	
+	return( kNoError );
+}
+
+/* doReserveKnown -	call to make sure there's room for the given number of new vertices */
+static char doReserveKnown( int num )
+{
+	Point3DPtr	known;
+	int			max = gMaxKnown ? gMaxKnown : 64;
+	
+	if( num <= gMaxKnown )
+		return( kNoError );
+	while( max < num )
+		max *= 2;
+	if( !(known = (Point3DPtr)realloc( (void *)gKnown, sizeof( Point3DRec ) * max )) )
+	{
+		printf( "\nNot enough memory for the new vertices!!!\n\n" );
+		return( kMemError );
+	}
+	gKnown = known;
+	gMaxKnown = max;
 	
 	return( kNoError );
 }
 
+/* doOpenStore -	call to open (or create) the found list store, loading anything it holds */
+/*	The store is an append-only log: a 64 byte header, then fixed size records, one for each polytope found, each
+	child added, and each polytope expanded. The header counts the committed records and carries their checksum;
+	it is rewritten after each record, so anything after the committed records is an interrupted append.		*/
+static char doOpenStore( char *name )
+{
+	struct stat		info;
+	char			*map, err = kNoError;
+	StoreHeaderRec	*header;
+	size_t			size;
+	
+	/* open the file */
+	if( ((gStoreFile = open( name, O_RDWR | O_CREAT, 0644 )) < 0) || fstat( gStoreFile, &info ) || (info.st_size < 0) )
+	{
+		printf( "Unable to open the store '%s'!!!\n", name );
+		return( kFileError );
+	}
+	size = (size_t)info.st_size;
+	
+	/* a new store: write an empty header */
+	if( !size )
+	{
+		memset( &gStoreHeader, 0, sizeof( gStoreHeader ) );
+		memcpy( gStoreHeader.magic, kStoreMagic, sizeof( gStoreHeader.magic ) );
+		gStoreHeader.version = kStoreVersion;
+		gStoreHeader.recordSize = sizeof( StoreRecordRec );
+		gStoreHeader.checksum = kFNVOffset;
+		if( pwrite( gStoreFile, &gStoreHeader, sizeof( gStoreHeader ), 0 ) != sizeof( gStoreHeader ) )
+		{
+			printf( "Unable to write the store '%s'!!!\n", name );
+			return( kFileError );
+		}
+		return( kNoError );
+	}
+	
+	/* map the existing store and check its integrity */
+	if( (size < sizeof( StoreHeaderRec )) || ((map = (char *)mmap( kFalse, size, PROT_READ, MAP_SHARED, gStoreFile, 0 )) == MAP_FAILED) )
+	{
+		printf( "Unable to read the store '%s'!!!\n", name );
+		return( kFileError );
+	}
+	header = (StoreHeaderRec *)map;
+	if( memcmp( header->magic, kStoreMagic, sizeof( header->magic ) ) || (header->version != kStoreVersion)
+		|| (header->recordSize != sizeof( StoreRecordRec )) || (header->numRecords < 0)
+		|| ((unsigned long long)header->numRecords > (size - sizeof( StoreHeaderRec )) / sizeof( StoreRecordRec ))
+		|| (doChecksum( kFNVOffset, map + sizeof( StoreHeaderRec ), header->numRecords * sizeof( StoreRecordRec ) ) != header->checksum) )
+	{
+		printf( "The store '%s' is damaged!!!\n", name );
+		err = kFileError;
+	}
+	else
+	{
+		gStoreHeader = *header;
+		err = doLoadStore( (StoreRecordPtr)(map + sizeof( StoreHeaderRec )), gStoreHeader.numRecords );
+	}
+	munmap( (void *)map, size );
+	
+	/* drop any record that was only partly appended */
+	if( (err == kNoError) && ftruncate( gStoreFile, sizeof( StoreHeaderRec ) + gStoreHeader.numRecords * sizeof( StoreRecordRec ) ) )
+		err = kFileError;
+	
+	return( err );
+}
+
+/* doLoadStore -	call to rebuild the found list from the store records */
+static char doLoadStore( StoreRecordPtr records, long long numRecords )
+{
+	PolytopeHandle	found;
+	long long		r;
+	int				numFound = 0, numFrontier = 0, fd = gStoreFile;
+	char			err = kNoError;
+	
+	if( !(found = (PolytopeHandle)malloc( sizeof( PolytopePtr ) * (numRecords + 1) )) )
+		return( kMemError );
+	
+	/* replay the records (without writing them back to the store) */
+	gStoreFile = -1;
+	for( r = 0; (r < numRecords) && (err == kNoError); r++ )
+	{
+		StoreRecordPtr	rec = records + r;
+		PolytopePtr		p;
+		
+		if( (rec->index < 0) || (rec->index > numFound) || ((rec->type != kStorePolytope) && (rec->index == numFound)) )
+			err = kFileError;
+		else switch( rec->type )
+		{
+			case kStorePolytope:
+				if( (rec->index != numFound) || (rec->numVertices < 4) || (rec->numVertices > kMaxVertices) )
+					err = kFileError;
+				else if( !(p = doNewPolytope( rec->numVertices )) )
+					err = kMemError;
+				else
+				{
+					memcpy( p->vertices, rec->vertices, sizeof( Point3DRec ) * p->numVertices );
+					if( (err = doAddPolytopeToList( p )) == kNoError )
+					{
+						p->frontier = kTrue;
+						found[numFound++] = p;
+					}
+				}
+				break;
+			case kStoreChild:
+				if( (rec->child < 0) || (rec->child >= numFound) )
+					err = kFileError;
+				else
+					err = doAddChildToList( found[rec->index], found[rec->child] );
+				break;
+			case kStoreExpanded:
+				found[rec->index]->expanded = kTrue;
+				found[rec->index]->frontier = kFalse;
+				break;
+			default:
+				err = kFileError;
+				break;
+		}
+	}
+	gStoreFile = fd;
+	
+	if( err == kNoError )
+	{
+		for( r = 0; r < numFound; r++ )
+			if( !found[r]->expanded )	numFrontier++;
+		printf( "Loaded %d polytopes (%d not yet expanded) from the store.\n\n", numFound, numFrontier );
+	}
+	else
+		printf( "Unable to load the store!!!\n" );
+	free( (void *)found );
+	
+	return( err );
+}
+
+/* doAppendToStore -	call to append a record to the store (if there is one) and commit it */
+static char doAppendToStore( short type, PolytopePtr p, PolytopePtr child )
+{
+	StoreRecordRec	rec;
+	
+	if( gStoreFile < 0 )
+		return( kNoError );
+	
+	/* fill in the record */
+	memset( &rec, 0, sizeof( rec ) );
+	rec.type = type;
+	rec.index = p->id - 1;
+	if( child )
+		rec.child = child->id - 1;
+	if( type == kStorePolytope )
+	{
+		if( p->numVertices > kMaxVertices )
+		{
+			printf( "Too many vertices to store a polytope!!!\n" );
+			return( kFileError );
+		}
+		rec.numVertices = p->numVertices;
+		memcpy( rec.vertices, p->vertices, sizeof( Point3DRec ) * p->numVertices );
+	}
+	
+	/* write it after the last committed record, then commit it */
+	if( pwrite( gStoreFile, &rec, sizeof( rec ), sizeof( StoreHeaderRec ) + gStoreHeader.numRecords * sizeof( rec ) ) != sizeof( rec ) )
+	{
+		printf( "Unable to write to the store!!!\n" );
+		return( kFileError );
+	}
+	gStoreHeader.numRecords++;
+	gStoreHeader.checksum = doChecksum( gStoreHeader.checksum, &rec, sizeof( rec ) );
+	if( pwrite( gStoreFile, &gStoreHeader, sizeof( gStoreHeader ), 0 ) != sizeof( gStoreHeader ) )
+	{
+		printf( "Unable to write to the store!!!\n" );
+		return( kFileError );
+	}
+	
+	return( kNoError );
+}
+
+/* doCloseStore -	call to flush and close the store */
+static void doCloseStore( void )
+{
+	if( gStoreFile >= 0 )
+	{
+		fsync( gStoreFile );
+		close( gStoreFile );
+		gStoreFile = -1;
+	}
+}
+
+/* doChecksum -	call to continue the FNV-1a hash of a run of bytes */
+static unsigned long long doChecksum( unsigned long long hash, void *data, size_t length )
+{
+	unsigned char	*byte = (unsigned char *)data;
+	
+	while( length-- )
+		hash = (hash ^ *byte++) * kFNVPrime;
+	
+	return( hash );
+}
+
 /* doDisposePolytopeList -	call to dispose of the polytope list */
+/*	The found polytopes, their vertices and their lists all live in the blocks of polytope storage, so we simply
+	free the blocks.																								*/
 static void doDisposePolytopeList( void )
 {
-	while( gPolyList )
+	short		i;
+	
+	while( gBlock )
 	{
-		PolyListPtr	temp = gPolyList->next;
+		char		*previous = *(char **)gBlock;
 		
-		doDisposePolytope( gPolyList->p );
-		free( (void *)gPolyList );
-		gPolyList = temp;
+		free( (void *)gBlock );
+		gBlock = previous;
 	}
+	if( gBuckets )
+		free( (void *)gBuckets );
+	gPolyList = gPolyListEnd = kFalse;
+	gBuckets = kFalse;
+	gNumBuckets = gNumFound = 0;
+	for( i = 0; i <= kMaxVertices; i++ )
+		gFreePolytopes[i] = kFalse;
+}
+
+/* doAllocate -	call to take some memory from the polytope storage (it is only released by doDisposePolytopeList) */
+static void *doAllocate( size_t size )
+{
+	void		*ptr;
+	
+	/* keep everything 8-byte aligned */
+	size = (size + 7) & ~(size_t)7;
+	
+	/* start a new block if needed (each block begins with a pointer to the one before) */
+	if( !gBlock || (gBlockUsed + size > kBlockSize) )
+	{
+		char		*block;
+		
+		if( size + sizeof( char * ) > kBlockSize )
+			return( kFalse );
+		if( !(block = (char *)malloc( kBlockSize )) )
+			return( kFalse );
+		*(char **)block = gBlock;
+		gBlock = block;
+		gBlockUsed = (sizeof( char * ) + 7) & ~(size_t)7;
+	}
+	
+	ptr = gBlock + gBlockUsed;
+	gBlockUsed += size;
+	
+	return( ptr );
 }
 
 /* doCreateMinimalPolytopes -	call to create the minimal polytopes */
 static char doCreateMinimalPolytopes( PolytopeHandle p )
 {
 	short 		i;
-	char		err;
 	
 	/* allocate the memory for the minimal polytopes */
 	if( !(p[0] = doNewPolytope( 4 )) )	return( kMemError );
@@ -215,9 +1328,19 @@ static char doCreateMinimalPolytopes( PolytopeHandle p )
 	MSPt( 12, 0, 1, 0, 0 );	MSPt( 12, 1, 0, 1, 0 );	MSPt( 12, 2, 1, 1, 2 );	MSPt( 12, 3, -1, 0, 0 );	MSPt( 12, 4, 0, -1, 0 );	MSPt( 12, 5, -1, -1, -2 );
 
 	
-	/* add the minimal polytopes to the list */
+	/* add the minimal polytopes to the list, unless they're already there from an earlier run */
 	for( i = 0; i < kNumMin; i++ )
-		if( err = doAddPolytopeToList( p[i] ) )	return( err );
+	{
+		PolytopePtr		q;
+		char			wasNew;
+		
+		if( !(q = doIsNewPolytope( p[i], &wasNew )) )		return( kMemError );
+		doDisposePolytope( p[i] );
+		p[i] = q;
+		
+		/* the seeds are grown in order, not when they turn up as children */
+		p[i]->frontier = kFalse;
+	}
 	
 	/* return success */
 	return( kNoError );
@@ -226,41 +1349,117 @@ static char doCreateMinimalPolytopes( PolytopeHandle p )
 /* doAddPolytopeToList -	call to add the polytope to the found list */
 static char doAddPolytopeToList( PolytopePtr p )
 {
-	/* find the end of the list and add on the polytope */
-	if( gPolyList )
+	PolyListPtr	entry;
+	char		err;
+	
+	/* add the polytope onto the end of the list */
+	if( !(entry = (PolyListPtr)doAllocate( sizeof( PolyListRec ) )) )
+		return( kMemError );
+	entry->p = p;
+	entry->next = kFalse;
+	if( gPolyListEnd )
 	{
-		PolyListPtr	foundList = gPolyList;
-		
-		while( foundList->next )	foundList = foundList->next;
-		
-		if( !(foundList->next = (PolyListPtr)malloc( sizeof( PolyListRec ) )) )
-			return( kMemError );
-		p->id = foundList->p->id + 1;
-		foundList->next->p = p;
-		foundList->next->next = kFalse;
+		p->id = gPolyListEnd->p->id + 1;
+		gPolyListEnd->next = entry;
 	}
 	else
 	{
-		if( !(gPolyList = (PolyListPtr)malloc( sizeof( PolyListRec ) )) )
-			return( kMemError );
 		p->id = 1;
-		gPolyList->p = p;
-		gPolyList->next = kFalse;
+		gPolyList = entry;
 	}
+	gPolyListEnd = entry;
+	
+	/* and into the hash table */
+	if( (err = doAddPolytopeToTable( p )) )
+		return( err );
 	
 	/* check whether the polytope is simplicial or not */
 	p->simplicial = doIsSimplicial( p );
 	
+	/* record the polytope in the store */
+	return( doAppendToStore( kStorePolytope, p, kFalse ) );
+}	
+
+/* doAddPolytopeToTable -	call to add the polytope to the hash table, growing the table as needed */
+static char doAddPolytopeToTable( PolytopePtr p )
+{
+	/* grow the table once it's full, rehashing the found list */
+	if( gNumFound >= gNumBuckets )
+	{
+		PolytopeHandle	buckets;
+		PolyListPtr		list;
+		long			numBuckets = gNumBuckets ? 2 * gNumBuckets : kMinBuckets;
+		
+		if( !(buckets = (PolytopeHandle)calloc( numBuckets, sizeof( PolytopePtr ) )) )
+			return( kMemError );
+		if( gBuckets )
+			free( (void *)gBuckets );
+		gBuckets = buckets;
+		gNumBuckets = numBuckets;
+		for( list = gPolyList; list; list = list->next )
+			if( list->p != p )
+			{
+				list->p->next = gBuckets[list->p->hash & (gNumBuckets - 1)];
+				gBuckets[list->p->hash & (gNumBuckets - 1)] = list->p;
+			}
+	}
+	
+	/* add the polytope */
+	p->hash = doHashPolytope( p );
+	p->next = gBuckets[p->hash & (gNumBuckets - 1)];
+	gBuckets[p->hash & (gNumBuckets - 1)] = p;
+	
+	/* report progress on long runs */
+	if( !(++gNumFound % 10000) )
+	{
+		printf( "Found %ld polytopes...\n", gNumFound );
+		fflush( stdout );
+	}
+	
 	return( kNoError );
-}	
+}
+
+/* doHashPolytope -	call to hash the GL(3,Z) invariants of the polytope: the multiset of |det(u,v,w)| over its vertices */
+static unsigned long long doHashPolytope( PolytopePtr p )
+{
+	long		dets[kMaxVertices * (kMaxVertices - 1) * (kMaxVertices - 2) / 6];
+	short		i, j, k, numDets = 0;
+	
+	/* find the determinants */
+	for( i = 0; i < p->numVertices; i++ )
+		for( j = i + 1; j < p->numVertices; j++ )
+			for( k = j + 1; k < p->numVertices; k++ )
+			{
+				Point3DPtr	a = p->vertices + i, b = p->vertices + j, c = p->vertices + k;
+				long		det = (long)a->x * (b->y * c->z - b->z * c->y) + (long)a->y * (b->z * c->x - b->x * c->z) + (long)a->z * (b->x * c->y - b->y * c->x);
+				short		l;
+				
+				/* insert it in order */
+				if( det < 0 )	det = -det;
+				for( l = numDets++; (l > 0) && (dets[l - 1] > det); l-- )
+					dets[l] = dets[l - 1];
+				dets[l] = det;
+			}
+	
+	return( doChecksum( doChecksum( kFNVOffset, &p->numVertices, sizeof( short ) ), dets, sizeof( long ) * numDets ) );
+}
 
 /* doNewPolytope -	call to create a new polytope with the given number of vertices */
 static PolytopePtr doNewPolytope( short numVertices )
 {
 	PolytopePtr	p;
 	
-	/* allocate the memory for the polytope */
-	if( !(p = (PolytopePtr)malloc( sizeof( PolytopeRec ) )) )
+	/* reuse a disposed of polytope if we can, otherwise take the polytope and its vertices from the storage */
+	if( (numVertices < 1) || (numVertices > kMaxVertices) )
+	{
+		printf( "\nA polytope can have at most %d vertices!!!\n\n", kMaxVertices );
+		return( kFalse );
+	}
+	if( (p = gFreePolytopes[numVertices]) )
+		gFreePolytopes[numVertices] = p->next;
+	else if( (p = (PolytopePtr)doAllocate( sizeof( PolytopeRec ) + sizeof( Point3DRec ) * numVertices )) )
+		p->vertices = (Point3DPtr)(p + 1);
+	else
 	{
 		printf( "\nNot enough memory to create new polytope!!!\n\n" );
 		return( kFalse );
@@ -272,69 +1471,42 @@ static PolytopePtr doNewPolytope( short numVertices )
 	p->numParents = 0;
 	p->children = kFalse;
 	p->parents = kFalse;
-
-	/* allocate the memory for the vertices */
-	if( !(p->vertices = (Point3DPtr)malloc( sizeof( Point3DRec ) * numVertices )) )
-	{
-		free( (void *)p );
-		printf( "\nNot enough memory to create new polytope!!!\n\n" );
-		return( kFalse );
-	}
+	p->expanded = kFalse;
+	p->frontier = kFalse;
+	p->hash = 0;
+	p->next = kFalse;
+	p->shard = kFalse;
 		
 	/* return the polytope */
 	return( p );
 }
 
-/* doNewPolytopeChild -	call to create a new child polytope */
-static PolytopePtr doNewPolytopeChild( PolytopePtr p )
+/* doCopyPolytope -	call to create a copy of a polytope's vertices (for keeping a polytope built elsewhere) */
+static PolytopePtr doCopyPolytope( PolytopePtr p )
 {
 	PolytopePtr	q;
 	short		i;
 	
 	/* allocate the memory for the polytope */
-	if( !(q = doNewPolytope( p->numVertices + 1 )) )
+	if( !(q = doNewPolytope( p->numVertices )) )
 		return( kFalse );
 	
-	/* set the known vertices */
+	/* set the vertices */
 	for( i = 0; i < p->numVertices; i++ )
 		q->vertices[i] = p->vertices[i];
 	
-	/* return the child */
+	/* return the copy */
 	return( q );
 }
 
-/* doDisposePolytope -	call to dispose of a polytope */
+/* doDisposePolytope -	call to dispose of a polytope that never made it onto the found list (so has no lists) */
 static void doDisposePolytope( PolytopePtr p )
 {
+	/* keep it for reuse */
 	if( p )
 	{
-		PolyListPtr		temp;
-		
-		/* dispose of the vertices */
-		if( p->vertices )	free( (void *)(p->vertices) );
-		
-		/* dispose of the children list */
-		temp = p->children;
-		while( temp )
-		{
-			PolyListPtr	next = temp->next;
-			
-			free( (void *)temp );
-			temp = next;
-		}
-		
-		/* dispose of the parent list */
-		temp = p->parents;
-		while( temp )
-		{
-			PolyListPtr	next = temp->next;
-			
-			free( (void *)temp );
-			temp = next;
-		}
-		
-		/* dispose of the polytope */
-		free( (void *)p );
+		p->next = gFreePolytopes[p->numVertices];
+		gFreePolytopes[p->numVertices] = p;
 	}
 }
 
@@ -459,7 +1631,7 @@ static void doAddPointToBoundingBox( BoundsPtr bbox, Point3DPtr a )
 /* doIsInternal -	call to test whether the given point is on the inside of the face or not (d = internal point, a = point on face, n = normal to face) */
 static char doIsInternal( Point3DPtr x, Point3DPtr n, Point3DPtr d, Point3DPtr a )
 {
-	short		parDot = MDot( *d, *n ) - MDot( *a, *n ), norDot = MDot( *x, *n ) - MDot( *a, *n );
+	long		parDot = MDot( *d, *n ) - MDot( *a, *n ), norDot = MDot( *x, *n ) - MDot( *a, *n );
 	
 	if( !parDot )				return( kFalse );
 	if( !norDot )				return( kTrue );
@@ -468,12 +1640,219 @@ static char doIsInternal( Point3DPtr x, Point3DPtr n, Point3DPtr d, Point3DPtr a
 	return( kTrue );
 }
 
+/* doFindFacets -	call to find the facets of the convex hull of the points (which must contain the origin in its interior) */
+/*	Each facet is given by its primitive outward normal and height, and a mask of the points which lie on it.	*/
+static short doFindFacets( Point3DPtr pts, short numPts, FacetPtr facets )
+{
+	short			i, j, k, l, numFacets = 0;
+	
+	for( i = 0; i < numPts; i++ )
+		for( j = i + 1; j < numPts; j++ )
+			for( k = j + 1; k < numPts; k++ )
+			{
+				long		u[3], v[3], nor[3], d, dot, hcf;
+				unsigned long	mask = 0;
+				
+				u[0] = pts[j].x - pts[i].x;	u[1] = pts[j].y - pts[i].y;	u[2] = pts[j].z - pts[i].z;
+				v[0] = pts[k].x - pts[i].x;	v[1] = pts[k].y - pts[i].y;	v[2] = pts[k].z - pts[i].z;
+				nor[0] = u[1] * v[2] - u[2] * v[1];
+				nor[1] = u[2] * v[0] - u[0] * v[2];
+				nor[2] = u[0] * v[1] - u[1] * v[0];
+				
+				/* orient the plane so that the origin is on the inside */
+				if( !(d = nor[0] * pts[i].x + nor[1] * pts[i].y + nor[2] * pts[i].z) )
+					continue;
+				if( d < 0 )
+				{
+					nor[0] = -nor[0];	nor[1] = -nor[1];	nor[2] = -nor[2];	d = -d;
+				}
+				
+				/* check it supports the points */
+				for( l = 0; l < numPts; l++ )
+				{
+					if( (dot = nor[0] * pts[l].x + nor[1] * pts[l].y + nor[2] * pts[l].z) > d )
+						break;
+					if( dot == d )
+						mask |= 1UL << l;
+				}
+				if( l < numPts )
+					continue;
+				
+				/* record it, unless we've already seen it */
+				for( l = 0; (l < numFacets) && (facets[l].mask != mask); l++ );
+				if( (l == numFacets) && (numFacets < kMaxFacets) )
+				{
+					hcf = doFindHCF( doFindHCF( nor[0], nor[1] ), nor[2] );
+					facets[numFacets].normal[0] = nor[0] / hcf;
+					facets[numFacets].normal[1] = nor[1] / hcf;
+					facets[numFacets].normal[2] = nor[2] / hcf;
+					facets[numFacets].height = d / hcf;
+					facets[numFacets].mask = mask;
+					numFacets++;
+				}
+			}
+	
+	return( numFacets );
+}
+
+/* doIsChildTerminal -	call to test whether each tetrahedron {v_i,v_j,newVertex,0} is free of non-vertex lattice points */
+/*	The answer doesn't depend on the order of the tests, so we try the cheap exact proofs first, and then work through
+	the pairs in order of how many candidates they have rejected so far this run (most candidates fail).	*/
+static char doIsChildTerminal( PolytopePtr p, Point3DPtr newVertex )
+{
+	char		rejected = kFalse, result;
+	short		i, j, k, n = p->numVertices;
+	long		evaluated = 0, scanned = 0;
+	Point3DRec	d, nor;
+	
+	gNumCandidates++;
+	if( gFixedOrder )
+	{
+		/* the plain search */
+		for( i = 0; (i < n) && !rejected; i++ )
+			for( j = i + 1; (j < n) && !rejected; j++ )
+			{
+				evaluated++;
+				scanned++;
+				rejected = !doIsFreeTetrahedron( p->vertices + i, p->vertices + j, newVertex );
+			}
+	}
+	else
+	{
+		/* a lattice point halfway along {0,newVertex} or {v_i,newVertex} lies on every non-degenerate tetrahedron
+		with that edge, and since p is 3-dimensional there is always one on {0,newVertex} */
+		rejected = MIsEven( *newVertex );
+		for( i = 0; (i < n) && !rejected; i++ )
+		{
+			MSubtract( *newVertex, p->vertices[i], d );
+			if( MIsEven( d ) )
+				for( j = 0; (j < n) && !rejected; j++ )
+					if( j != i )
+					{
+						evaluated++;
+						MNormal( p->vertices[j], *newVertex, nor );
+						rejected = (MDot( p->vertices[i], nor ) != 0);
+					}
+		}
+		
+		/* then the pairs, most successful first */
+		for( k = 0; (k < kMaxPairs) && !rejected; k++ )
+		{
+			i = gPairOrder[k] / kMaxVertices;
+			j = gPairOrder[k] % kMaxVertices;
+			if( j >= n )
+				continue;
+			evaluated++;
+			if( (result = doScreenTetrahedron( p->vertices + i, p->vertices + j, newVertex )) == kScreenUnknown )
+			{
+				scanned++;
+				result = doIsFreeTetrahedron( p->vertices + i, p->vertices + j, newVertex ) ? kScreenFree : kScreenNotFree;
+			}
+			if( result == kScreenNotFree )
+			{
+				gPairRejects[gPairOrder[k]]++;
+				rejected = kTrue;
+			}
+		}
+	}
+	if( !rejected )
+		return( kTrue );
+	
+	/* keep the statistics, re-ordering the pairs every so often */
+	gNumEvaluated += evaluated;
+	gNumScanned += scanned;
+	if( !scanned )
+		gNumScreened++;
+	if( !(++gNumRejected % kReorderInterval) && !gFixedOrder )
+		doReorderPairs();
+	
+	return( kFalse );
+}
+
+/* doScreenTetrahedron -	call to decide whether the tetrahedron {a,b,c,0} is lattice-point free without scanning it, if we can */
+/*	A degenerate tetrahedron counts as free (just as in doIsFreeTetrahedron), and one of determinant +-1 is unimodular.
+	A lattice triangle with no lattice points other than its vertices has normalised area 1, so if the cross product
+	of two edges of a face has a common factor then that face holds another lattice point.	*/
+static char doScreenTetrahedron( Point3DPtr a, Point3DPtr b, Point3DPtr c )
+{
+	long		ab[3], ac[3], bc[3], det;
+	
+	ab[0] = (long)a->y * b->z - (long)a->z * b->y;	ab[1] = (long)a->z * b->x - (long)a->x * b->z;	ab[2] = (long)a->x * b->y - (long)a->y * b->x;
+	ac[0] = (long)a->y * c->z - (long)a->z * c->y;	ac[1] = (long)a->z * c->x - (long)a->x * c->z;	ac[2] = (long)a->x * c->y - (long)a->y * c->x;
+	bc[0] = (long)b->y * c->z - (long)b->z * c->y;	bc[1] = (long)b->z * c->x - (long)b->x * c->z;	bc[2] = (long)b->x * c->y - (long)b->y * c->x;
+	det = a->x * bc[0] + a->y * bc[1] + a->z * bc[2];
+	
+	if( (det == 0) || (det == 1) || (det == -1) )
+		return( kScreenFree );
+	
+	/* the faces through the origin, then the face {a,b,c} (whose normal is ab - ac + bc) */
+	if( (doFindHCF( doFindHCF( ab[0], ab[1] ), ab[2] ) > 1) || (doFindHCF( doFindHCF( ac[0], ac[1] ), ac[2] ) > 1)
+		|| (doFindHCF( doFindHCF( bc[0], bc[1] ), bc[2] ) > 1)
+		|| (doFindHCF( doFindHCF( ab[0] - ac[0] + bc[0], ab[1] - ac[1] + bc[1] ), ab[2] - ac[2] + bc[2] ) > 1) )
+		return( kScreenNotFree );
+	
+	return( kScreenUnknown );
+}
+
+/* doFindHCF -	call to find the highest common factor of a and b (which is positive unless both are zero) */
+static long doFindHCF( long a, long b )
+{
+	long		r;
+	
+	if( a < 0 )		a = -a;
+	if( b < 0 )		b = -b;
+	while( b )
+	{
+		r = a % b;
+		a = b;
+		b = r;
+	}
+	
+	return( a );
+}
+
+/* doReorderPairs -	call to sort the pairs of vertices so that those which have rejected the most candidates come first */
+static void doReorderPairs( void )
+{
+	qsort( (void *)gPairOrder, kMaxPairs, sizeof( short ), doComparePairs );
+}
+
+/* doComparePairs -	call to compare two pairs of vertices by the number of candidates they've rejected (ties in index order) */
+static int doComparePairs( const void *a, const void *b )
+{
+	short		i = *(short *)a, j = *(short *)b;
+	
+	if( gPairRejects[i] != gPairRejects[j] )
+		return( (gPairRejects[i] > gPairRejects[j]) ? -1 : 1 );
+	
+	return( i - j );
+}
+
+/* doReportRejections -	call to print how much work it took, on average, to reject a candidate child */
+static void doReportRejections( void )
+{
+	if( !gNumRejected )
+		return;
+	printf( "\n%sRejected %ld of %ld candidates (%s),\n", kRuleOff, gNumRejected, gNumCandidates, gFixedOrder ? "fixed order" : "adaptive order" );
+	printf( "\tevaluating %.2f tetrahedra each on average, %.2f of them by a full scan.\n", (double)gNumEvaluated / gNumRejected, (double)gNumScanned / gNumRejected );
+	printf( "\t%ld candidates were rejected without a full scan.\n", gNumScreened );
+}
+
+/* doFindKnownVertex -	call to find the new vertex amongst those the shard found for the children of p (if it's there) */
+static ShardKnownPtr doFindKnownVertex( PolytopePtr p, Point3DPtr newVertex )
+{
+	return( (ShardKnownPtr)bsearch( (void *)newVertex, (void *)p->shard->known, p->shard->numKnown, sizeof( ShardKnownRec ),
+		doComparePoints ) );
+}
+
 /* doIsChildFano -	call to test whether the child polytope is Fano, if so we recurse on the child */
 static char doIsChildFano( PolytopePtr p, Point3DPtr newVertex )
 {
-	char			wasNew;
-	short			i, j;
-	PolytopePtr		q, child;
+	char			wasNew, err;
+	short			i;
+	PolytopeRec		q;
+	Point3DRec		vertices[kMaxVertices];
+	PolytopePtr		child;
 	
 	/* check the new vertex isn't actually an old vertex or the origin */
 	if( !newVertex->x && !newVertex->y && !newVertex->z )
@@ -482,24 +1861,46 @@ static char doIsChildFano( PolytopePtr p, Point3DPtr newVertex )
 		if( MPointsEqual( *newVertex, p->vertices[i] ) )
 			return( kNoError );
 		
-	/* scan through all the possible tetrahedra checking for non-zero, non-vertex lattice points */
-	for( i = 0; i < p->numVertices; i++ )
-		for( j = i + 1; j < p->numVertices; j++ )
-			if( !doIsFreeTetrahedron( p->vertices + i, p->vertices + j, newVertex ) )
-				return( kNoError );
+	/* scan through all the possible tetrahedra checking for non-zero, non-vertex lattice points (unless we're merging
+	   shards, and the shard that grew p has done so already) */
+	if( gShardPolys )
+	{
+		if( !doFindKnownVertex( p, newVertex ) )
+			return( kNoError );
+	}
+	else if( !doIsChildTerminal( p, newVertex ) )
+		return( kNoError );
 	
-	/* create the memory for the child polytope and add in the new vertex */
-	if( !(q = doNewPolytopeChild( p )) )
+	/* build the child polytope in place (it's only copied into the storage if it's new) */
+	if( p->numVertices >= kMaxVertices )
+	{
+		printf( "\nA polytope can have at most %d vertices!!!\n\n", kMaxVertices );
 		return( kMemError );
-	q->vertices[p->numVertices] = *newVertex;
+	}
+	
+	/* a shard only records the new vertex (the child may belong to another shard) */
+	if( gSharding )
+		return( doAddKnownVertex( newVertex ) );
+	q.numVertices = p->numVertices + 1;
+	q.vertices = vertices;
+	for( i = 0; i < p->numVertices; i++ )
+		vertices[i] = p->vertices[i];
+	vertices[p->numVertices] = *newVertex;
 	
-	/* check the new polytope against the polytope list and save the results */
-	child = doIsNewPolytope( q, &wasNew );
-	doAddChildToList( p, child );
+	/* check the new polytope against the polytope list (or, when merging, the shards' list) and save the results */
+	if( !(child = gShardPolys ? doIsNewShardPolytope( p, newVertex, &q, &wasNew ) : doIsNewPolytope( &q, &wasNew )) )
+		return( kMemError );
+	if( (err = doAddChildToList( p, child )) )
+		return( err );
 		
-	/* finish up by inducting if required */
-	if( !wasNew )	doDisposePolytope( q );
-	else			return( doEnlargePolytope( q ) );
+	/* finish up by inducting if required (including on a polytope an earlier run found but never expanded) */
+	if( wasNew )
+		return( doEnlargePolytope( child ) );
+	if( child->frontier )
+	{
+		child->frontier = kFalse;
+		return( doEnlargePolytope( child ) );
+	}
 	
 	return( kNoError );
 }
@@ -509,11 +1910,22 @@ static char doEnlargePolytope( PolytopePtr p )
 {	
 	char			err;
 	
+	/* when merging shards, find the new vertices the shard that grew p found */
+	if( gShardPolys && ((err = doFindKnownVertices( p )) != kNoError) )
+		return( err );
+	
 	/* try to extend the polytope by adding in a new vertex */
 	if( (err = doAddOverVertex( p )) == kNoError )
 		if( (err = doAddOverEdge( p )) == kNoError )
 			err = doAddOverFace( p );
 	
+	/* all the children of p are now known */
+	if( err == kNoError )
+	{
+		p->expanded = kTrue;
+		err = doAppendToStore( kStoreExpanded, p, kFalse );
+	}
+	
 	/* return any errors */
 	return( err );
 }
@@ -687,7 +2099,7 @@ static char doUpdateList( PolytopePtr p, PolyListHandle list )
 	}
 	
 	/* allocate the memory */
-	if( !(entry = (PolyListPtr)malloc( sizeof( PolyListRec ) )) )
+	if( !(entry = (PolyListPtr)doAllocate( sizeof( PolyListRec ) )) )
 		return( kFalse );
 	
 	/* assign the child to the list */
@@ -706,48 +2118,61 @@ static char doUpdateList( PolytopePtr p, PolyListHandle list )
 }
 
 /* doAddChildToList -	call to add the child to the list of children (also adds the parent to the child's list) */
-static void doAddChildToList( PolytopePtr p, PolytopePtr child )
+static char doAddChildToList( PolytopePtr p, PolytopePtr child )
 {
-	/* first we add the child to the parent's list */
+	char		err = kNoError;
+	
+	/* first we add the child to the parent's list (recording it in the store) */
 	if( doUpdateList( child, &(p->children) ) )
+	{
 		p->numChildren++;
+		err = doAppendToStore( kStoreChild, p, child );
+	}
 	
 	/* now we add the parent to the child's list */
 	if( doUpdateList( p, &(child->parents) ) )
 		child->numParents++;
+	
+	return( err );
 }
 
 /* doIsNewPolytope -	call to check the polytope against the found list and, if necessary, add it to the list */
+/*	A new polytope is copied into the storage before being added, so p itself is never kept. */
 static PolytopePtr doIsNewPolytope( PolytopePtr p, char *wasNew )
 {
-	PolyListPtr	foundList = gPolyList;
+	PolytopePtr			q;
+	unsigned long long	hash = doHashPolytope( p );
 	
-	/* scan through the list looking for polytopes with the same number of vertices and compairing them to p */
+	/* scan through the polytopes with the same invariants, compairing them to p */
 	*wasNew = kFalse;
-	while( foundList )
-	{
-		if( foundList->p->numVertices == p->numVertices )
-			if( doArePolytopesSimilar( p, foundList->p ) )
-				return( foundList->p );
-		foundList = foundList->next;
-	}
+	if( gNumBuckets )
+		for( q = gBuckets[hash & (gNumBuckets - 1)]; q; q = q->next )
+			if( (q->hash == hash) && (q->numVertices == p->numVertices) )
+				if( doArePolytopesSimilar( p, q ) )
+					return( q );
 	
-	/* the polytope must be new; add it to the list */
+	/* the polytope must be new; add a copy of it to the list */
 	*wasNew = kTrue;
-	doAddPolytopeToList( p );
+	if( !(q = doCopyPolytope( p )) )
+		return( kFalse );
+	if( doAddPolytopeToList( q ) != kNoError )
+		return( kFalse );
 	
-	return( p );
+	return( q );
 }
 
 /* doArePolytopesSimilar -	call to check whether the two given polytopes are the same up to GL(3,Z) */
 static char doArePolytopesSimilar( PolytopePtr p, PolytopePtr q )
 {
-	PolytopePtr	c;
+	PolytopeRec	c;
+	Point3DRec	vertices[kMaxVertices];
 	short		i, j, k;
 	
 	/* create a copy of p to apply transformations to */
-	if( !(c = doNewPolytope( p->numVertices )) )
-		return( kFalse );
+	c.numVertices = p->numVertices;
+	c.vertices = vertices;
+	for( i = 0; i < p->numVertices; i++ )
+		vertices[i] = p->vertices[i];
 	
 	/* try finding a rotation to switch between the two polytopes */
 	for( i = 0; i < p->numVertices; i++ )
@@ -755,14 +2180,9 @@ static char doArePolytopesSimilar( PolytopePtr p, PolytopePtr q )
 			if( i != j )
 				for( k = 0; k < p->numVertices; k++ )
 					if( (i != k) && (j != k) )
-						if( doRotatePolytope( c, p, q, i, j, k ) )
-							if( doArePolytopesSame( c, q ) )
-							{
-								doDisposePolytope( c );
+						if( doRotatePolytope( &c, p, q, i, j, k ) )
+							if( doArePolytopesSame( &c, q ) )
 								return( kTrue );
-							}
-	
-	doDisposePolytope( c );
 	
 	return( kFalse );
 }
@@ -835,55 +2255,50 @@ static char doArePolytopesSame( PolytopePtr p, PolytopePtr q )
 }
 
 /* doAssignIDs -	call to assign the polytope ID numbers */
+/*	The polytopes are numbered by number of vertices, then by number of children, then in the order found. */
 static void doAssignIDs( void )
 {
-	short			curID = 1, curVertex = 4, numPolys;
-	
-	/* step through the list, first in vertex order */
-	do
+	PolytopeHandle	order;
+	PolyListPtr		temp;
+	long			numPolys = 0, i;
+	
+	/* list the polytopes in the order found (their IDs are still the order found) */
+	for( temp = gPolyList; temp; temp = temp->next )
+		numPolys++;
+	if( !(order = (PolytopeHandle)malloc( sizeof( PolytopePtr ) * (numPolys + 1) )) )
 	{
-		PolyListPtr		temp = gPolyList;
-		short			maxNumChildren = 0, count;
-		
-		/* find out how many polytopes there are with the current number of vertices */
-		numPolys = 0;
-		while( temp )
-		{
-			if( temp->p->numVertices == curVertex )
-			{
-				numPolys++;
-				if( temp->p->numChildren > maxNumChildren )
-					maxNumChildren = temp->p->numChildren;
-			}
-			temp = temp->next;
-		}
-		
-		/* if there were some polytopes, step throug assigning IDs based on the number of children */
-		for( count = 0; count <= maxNumChildren; count++ )
-		{
-			temp = gPolyList;
-			while( temp )
-			{
-				if( (temp->p->numVertices == curVertex) && (temp->p->numChildren == count) )
-				{
-					temp->p->id = curID;
-					curID++;
-				}
-				temp = temp->next;
-			}
-		}
-		
-		/* move on */
-		curVertex++;
-	} while( numPolys );
+		printf( "Not enough memory to assign the polytope IDs!!!\n" );
+		return;
+	}
+	for( i = 0, temp = gPolyList; temp; temp = temp->next )
+		order[i++] = temp->p;
+	
+	/* sort them and number them */
+	qsort( (void *)order, numPolys, sizeof( PolytopePtr ), doCompareIDOrder );
+	for( i = 0; i < numPolys; i++ )
+		order[i]->id = i + 1;
+	
+	free( (void *)order );
+}
+
+/* doCompareIDOrder -	call to compare two polytopes by number of vertices, then number of children, then order found */
+static int doCompareIDOrder( const void *a, const void *b )
+{
+	PolytopePtr		p = *(PolytopePtr *)a, q = *(PolytopePtr *)b;
+	
+	if( p->numVertices != q->numVertices )	return( p->numVertices - q->numVertices );
+	if( p->numChildren != q->numChildren )	return( p->numChildren - q->numChildren );
+	
+	return( (p->id > q->id) - (p->id < q->id) );
 }
 
 /* doSaveResults -	call to output the raw data (as a text file) */
 static void doSaveResults( void )
 {
-	short		i, maxID = 0;
-	FILE		*dataFile;
-	PolyListPtr	temp = gPolyList;
+	int				i, maxID = 0;
+	FILE			*dataFile;
+	PolyListPtr		temp = gPolyList;
+	PolytopeHandle	byID;
 	
 	/* find the maximum ID */
 	while( temp )
@@ -892,10 +2307,20 @@ static void doSaveResults( void )
 		temp = temp->next;
 	}
 	
+	/* index the polytopes by ID */
+	if( !(byID = (PolytopeHandle)calloc( maxID + 1, sizeof( PolytopePtr ) )) )
+	{
+		printf( "Not enough memory to save the polytope data!!!\n" );
+		return;
+	}
+	for( temp = gPolyList; temp; temp = temp->next )
+		byID[temp->p->id] = temp->p;
+	
 	/* create the new file */
 	if( !(dataFile = fopen( "Polytope_Data.txt", "w" )) )
 	{
 		printf( "Unable to create the polytope data file!!!\n" );
+		free( (void *)byID );
 		return;
 	}
 	
@@ -904,49 +2329,248 @@ static void doSaveResults( void )
 	
 	/* output the list data */
 	for( i = 1; i <= maxID; i++ )
-	{		
-		char			found = kFalse;
+		if( byID[i] )
+		{		
+			PolytopePtr	p = byID[i];
+			
+			/* fill in the data for the polytope */
+			fprintf( dataFile, "%d\t%d\t%d\t%d\t", i, p->numVertices, p->numParents, p->numChildren );
+			if( p->simplicial )
+			{
+				if( !p->numParents )			fprintf( dataFile, "1\t1\t0\n" );
+				else if( !p->numChildren )		fprintf( dataFile, "1\t0\t1\n" );
+				else							fprintf( dataFile, "1\t0\t0\n" );
+			}
+			else if( !p->numParents )			fprintf( dataFile, "0\t1\t0\n" );
+			else if( !p->numChildren )			fprintf( dataFile, "0\t0\t1\n" );
+			else								fprintf( dataFile, "0\t0\t0\n" );
+			
+			/* write the vertices */
+			doWriteVertices( p, dataFile );
+			
+			/* write the parent list */
+			doWriteList( p->parents, dataFile );
+			
+			/* write the children list */
+			doWriteList( p->children, dataFile );
+			
+			/* rule off */
+			fprintf( dataFile, "---\n" );
+		}
+	
+	/* close the file */
+	fclose( dataFile );
+	
+	/* and work out the invariants */
+	doSaveInvariants( byID, maxID );
+	free( (void *)byID );
+}
+
+/* doSaveInvariants -	call to calculate the invariants of every polytope (in parallel) and save them to the invariants file */
+/*	The invariants are worked out a batch of IDs at a time, so the memory needed doesn't grow with the number of
+	polytopes.																									*/
+static void doSaveInvariants( PolytopeHandle byID, int maxID )
+{
+	int				i, j, base, numThreads;
+	char			started[kMaxThreads];
+	FILE			*dataFile;
+	InvariantsPtr	invariants;
+	InvariantsJobRec	jobs[kMaxThreads];
+	pthread_t		threads[kMaxThreads];
+	
+	if( !(invariants = (InvariantsPtr)calloc( kInvariantsBatch, sizeof( InvariantsRec ) )) )
+	{
+		printf( "Not enough memory to calculate the invariants!!!\n" );
+		return;
+	}
+	
+	/* create the new file */
+	if( !(dataFile = fopen( "Polytope_Invariants.txt", "w" )) )
+	{
+		printf( "Unable to create the polytope invariants file!!!\n" );
+		free( (void *)invariants );
+		return;
+	}
+	
+	/* write the data header */
+	fprintf( dataFile, "Polytope ID\tVolume\tNum Boundary Points\tNum Interior Points\tNum Facets\t-K^3\nh* Vector\nDual Vertex List (numerators)\nDual Vertex Denominators\n---\n" );
+	
+	if( (numThreads = (int)sysconf( _SC_NPROCESSORS_ONLN )) < 1 )		numThreads = 1;
+	if( numThreads > kMaxThreads )										numThreads = kMaxThreads;
+	for( base = 1; base <= maxID; base += kInvariantsBatch )
+	{
+		int			last = (maxID - base < kInvariantsBatch) ? maxID : base + kInvariantsBatch - 1;
 		
-		temp = gPolyList;
-		while( temp && !found )
+		/* deal the batch out between the threads (doing any that can't be started here) */
+		for( i = 0; i < numThreads; i++ )
 		{
-			if( temp->p->id == i )
+			jobs[i].byID = byID;
+			jobs[i].invariants = invariants;
+			jobs[i].base = base;
+			jobs[i].first = base + i;
+			jobs[i].step = numThreads;
+			jobs[i].maxID = last;
+			started[i] = (numThreads > 1) && !pthread_create( threads + i, NULL, doInvariantsThread, (void *)(jobs + i) );
+			if( !started[i] )
+				doInvariantsThread( (void *)(jobs + i) );
+		}
+		for( i = 0; i < numThreads; i++ )
+			if( started[i] )
+				pthread_join( threads[i], NULL );
+		
+		/* output the invariants */
+		for( i = base; i <= last; i++ )
+			if( byID[i] )
 			{
-				PolyListPtr	child = temp->p->children, parent = temp->p->parents;
+				InvariantsPtr	inv = invariants + (i - base);
 				
-				/* set the found flag to true */
-				found = kTrue;
+				fprintf( dataFile, "%d\t%d\t%d\t%d\t%d\t%lld", i, inv->volume, inv->boundary, inv->interior, inv->numFacets, inv->degree[0] );
+				if( inv->degree[1] != 1 )
+					fprintf( dataFile, "/%lld", inv->degree[1] );
+				fprintf( dataFile, "\n%ld\t%ld\t%ld\t%ld\n", inv->hStar[0], inv->hStar[1], inv->hStar[2], inv->hStar[3] );
 				
-				/* fill in the data for the polytope */
-				fprintf( dataFile, "%d\t%d\t%d\t%d\t", i, temp->p->numVertices, temp->p->numParents, temp->p->numChildren );
-				if( temp->p->simplicial )
+				/* the dual vertices, in the same layout as the vertices */
+				for( j = 0; j < 4; j++ )
 				{
-					if( !temp->p->numParents )			fprintf( dataFile, "1\t1\t0\n" );
-					else if( !temp->p->numChildren )	fprintf( dataFile, "1\t0\t1\n" );
-					else								fprintf( dataFile, "1\t0\t0\n" );
+					int		k;
+					
+					for( k = 0; k < inv->numFacets; k++ )
+						fprintf( dataFile, (k == inv->numFacets - 1) ? "%ld\n" : "%ld\t", (j < 3) ? inv->facets[k].normal[j] : inv->facets[k].height );
 				}
-				else if( !temp->p->numParents )			fprintf( dataFile, "0\t1\t0\n" );
-				else if( !temp->p->numChildren )		fprintf( dataFile, "0\t0\t1\n" );
-				else									fprintf( dataFile, "0\t0\t0\n" );
-				
-				/* write the vertices */
-				doWriteVertices( temp->p, dataFile );
-				
-				/* write the parent list */
-				doWriteList( parent, dataFile );
-				
-				/* write the children list */
-				doWriteList( child, dataFile );
 				
 				/* rule off */
 				fprintf( dataFile, "---\n" );
 			}
-			temp = temp->next;
-		}
 	}
 	
 	/* close the file */
 	fclose( dataFile );
+	free( (void *)invariants );
+}
+
+/* doInvariantsThread -	call to calculate the invariants of the polytopes in the given job */
+static void *doInvariantsThread( void *job )
+{
+	InvariantsJobPtr	j = (InvariantsJobPtr)job;
+	int					i;
+	
+	for( i = j->first; i <= j->maxID; i += j->step )
+		if( j->byID[i] )
+			doCalculateInvariants( j->byID[i], j->invariants + (i - j->base) );
+	
+	return( NULL );
+}
+
+/* doCalculateInvariants -	call to calculate the invariants of the polytope, exactly */
+/*	By Ehrhart reciprocity h*_3 is the number of interior points, and L(P) = 4 + h*_1, L(2P) = 10 + 4h*_1 + h*_2; the
+	normalised volume is the sum of the h*-vector. The dual has a vertex n/h for each facet {n.x = h}, and a facet for
+	each vertex v of P, whose vertices are those of the facets through v: we order them by walking from one facet to
+	the next over a shared edge, and fan triangulate from the origin to get -K^3.	*/
+static void doCalculateInvariants( PolytopePtr p, InvariantsPtr inv )
+{
+	long		all[2], interior[2];
+	short		i, j, k, l;
+	
+	/* the facets, and the lattice points in P and 2P */
+	inv->numFacets = doFindFacets( p->vertices, p->numVertices, inv->facets );
+	doCountLatticePoints( p, inv->facets, inv->numFacets, 1, all, interior );
+	doCountLatticePoints( p, inv->facets, inv->numFacets, 2, all + 1, interior + 1 );
+	inv->boundary = all[0] - interior[0];
+	inv->interior = interior[0];
+	inv->hStar[0] = 1;
+	inv->hStar[1] = all[0] - 4;
+	inv->hStar[2] = all[1] - 10 - 4 * inv->hStar[1];
+	inv->hStar[3] = interior[0];
+	inv->volume = inv->hStar[0] + inv->hStar[1] + inv->hStar[2] + inv->hStar[3];
+	
+	/* the volume of the dual */
+	inv->degree[0] = 0;
+	inv->degree[1] = 1;
+	for( l = 0; l < p->numVertices; l++ )
+	{
+		short		cycle[kMaxFacets], numCycle = 0, prev = -1, cur;
+		
+		/* start from any facet through the vertex, and walk round */
+		for( i = 0; (i < inv->numFacets) && !(inv->facets[i].mask & (1UL << l)); i++ );
+		for( cur = i; (cur < inv->numFacets) && (numCycle < kMaxFacets); )
+		{
+			cycle[numCycle++] = cur;
+			for( j = 0; j < inv->numFacets; j++ )
+			{
+				unsigned long	common = inv->facets[j].mask & inv->facets[cur].mask;
+				
+				if( (j != cur) && (j != prev) && (common & (1UL << l)) && (common & (common - 1)) )
+					break;
+			}
+			prev = cur;
+			if( (cur = j) == cycle[0] )
+				break;
+		}
+		
+		/* fan triangulate the dual facet */
+		for( k = 1; k + 1 < numCycle; k++ )
+		{
+			FacetPtr	a = inv->facets + cycle[0], b = inv->facets + cycle[k], c = inv->facets + cycle[k + 1];
+			long long	det;
+			
+			det = a->normal[0] * (b->normal[1] * c->normal[2] - b->normal[2] * c->normal[1])
+				+ a->normal[1] * (b->normal[2] * c->normal[0] - b->normal[0] * c->normal[2])
+				+ a->normal[2] * (b->normal[0] * c->normal[1] - b->normal[1] * c->normal[0]);
+			doAddFraction( inv->degree, (det < 0) ? -det : det, (long long)a->height * b->height * c->height );
+		}
+	}
+}
+
+/* doCountLatticePoints -	call to count the lattice points in tP (and in its interior), a line at a time */
+static void doCountLatticePoints( PolytopePtr p, FacetPtr facets, int numFacets, int t, long *all, long *interior )
+{
+	BoundsRec	bbox = {0,0,0,0,0,0};
+	short		i, x, y;
+	
+	for( i = 0; i < p->numVertices; i++ )
+		doAddPointToBoundingBox( &bbox, p->vertices + i );
+	*all = *interior = 0;
+	
+	/* for each (x,y), each facet bounds z above or below (or rules out the line altogether) */
+	for( x = t * bbox.back; x <= t * bbox.front; x++ )
+		for( y = t * bbox.left; y <= t * bbox.right; y++ )
+		{
+			long		lo[2] = {-32768, -32768}, hi[2] = {32767, 32767};
+			short		s, f;
+			
+			for( f = 0; f < numFacets; f++ )
+				for( s = 0; s < 2; s++ )
+				{
+					long	c = facets[f].normal[2], rhs = t * facets[f].height - s - facets[f].normal[0] * x - facets[f].normal[1] * y, b;
+					
+					if( c > 0 )
+					{
+						b = (rhs >= 0) ? rhs / c : -((-rhs + c - 1) / c);
+						if( b < hi[s] )		hi[s] = b;
+					}
+					else if( c < 0 )
+					{
+						b = (rhs <= 0) ? (-rhs + (-c) - 1) / (-c) : -(rhs / (-c));
+						if( b > lo[s] )		lo[s] = b;
+					}
+					else if( rhs < 0 )
+						hi[s] = lo[s] - 1;
+				}
+			if( hi[0] >= lo[0] )		*all += hi[0] - lo[0] + 1;
+			if( hi[1] >= lo[1] )		*interior += hi[1] - lo[1] + 1;
+		}
+}
+
+/* doAddFraction -	call to add a/b to the fraction sum (kept in lowest terms) */
+static void doAddFraction( long long *sum, long long a, long long b )
+{
+	long long	hcf;
+	
+	sum[0] = sum[0] * b + a * sum[1];
+	sum[1] *= b;
+	hcf = doFindHCF( sum[0], sum[1] );
+	sum[0] /= hcf;
+	sum[1] /= hcf;
 }
 
 /* doWriteVertices -	call to write the vertices to the given file */
@@ -985,32 +2609,29 @@ static void doWriteList( PolyListPtr list, FILE *dataFile )
 	/* write the list */
 	if( list )
 	{
-		short		maxID = 0, count;
-		PolyListPtr	temp = list;
+		int			*ids, numIDs = 0, count;
+		PolyListPtr	temp;
 		
-		/* find the maximum ID */
-		while( temp )
-		{
-			if( temp->p->id > maxID )	maxID = temp->p->id;
-			temp = temp->next;
-		}
+		/* collect the IDs */
+		for( temp = list; temp; temp = temp->next )
+			numIDs++;
+		if( !(ids = (int *)malloc( sizeof( int ) * numIDs )) )
+			return;
+		for( count = 0, temp = list; temp; temp = temp->next )
+			ids[count++] = temp->p->id;
 		
 		/* now output the list in numerical order */
-		for( count = 1; count < maxID; count++ )
-		{
-			char		found = kFalse;
-			
-			temp = list;
-			while( temp && !found )
-			{
-				if( temp->p->id == count )
-				{
-					fprintf( dataFile, "%d\t", count );
-					found = kTrue;
-				}
-				temp = temp->next;
-			}
-		}
-		fprintf( dataFile, "%d\n", maxID );
+		qsort( (void *)ids, numIDs, sizeof( int ), doCompareIDs );
+		for( count = 0; count < numIDs - 1; count++ )
+			fprintf( dataFile, "%d\t", ids[count] );
+		fprintf( dataFile, "%d\n", ids[numIDs - 1] );
+		
+		free( (void *)ids );
 	}
 }
+
+/* doCompareIDs -	call to compare two IDs */
+static int doCompareIDs( const void *a, const void *b )
+{
+	return( *(int *)a - *(int *)b );
+}
@@ -13,63 +13,584 @@ Modified July, 2007.
 /* standard libraries */
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
 
 /* application constants */
 #define	kTrue			1		/* useful truth values */
 #define	kFalse			0
 #define	kRuleOff		"-------------------------------------------------\n"
+#define	kNoSplit		-1		/* the search isn't being split into tasks */
+#define	kMaxThreads		256		/* the most threads a parallel run can use */
+#define	kQueueSize		4096	/* the number of weights waiting to be written that the queue can hold */
+#define	kFlushSize		65536	/* how much formatted output to collect before writing it */
+#define	kFormatTeX		0		/* the output file formats */
+#define	kFormatCSV		1
+#define	kFormatBinary	2
+#define	kCheckpointInterval	600	/* the default time between checkpoints (in seconds) */
+#define	kMinMultiples	1024	/* the initial size of the multiples table */
+#define	kMaxMultiples	(1L << 26)	/* the largest it can grow to (beyond that we count directly) */
+#define	kBlockSize		64		/* the number of consecutive \kappa whose multiples are counted directly at once */
+#define	kDivisorCacheSize	4096	/* the number of divisor lists to cache */
+#define	kMinPrimeLimit	1024	/* the smallest sieve of primes */
+#define	kMaxPrimeLimit	(1L << 24)	/* the largest (beyond that we divide by odd numbers instead) */
+#define	kEstimateDepth	4		/* how many levels down the cost of the slices is estimated (unless told otherwise) */
+
+/* macros */
+#define	MInline			static inline __attribute__((always_inline))
+#ifdef kInstrument		/* compile with -DkInstrument to collect statistics on the search (see doWriteStats) */
+#define	MStat( w, statement )			do { if( (w)->stats ) { statement; } } while( 0 )
+#define	MTimed( w, total, statement )	if( (w)->stats ) { double MStart = doNow(); statement; total += doNow() - MStart; } else { statement; }
+#else
+#define	MStat( w, statement )			do { } while( 0 )
+#define	MTimed( w, total, statement )	statement;
+#endif
 
 /* structure definitions */
 typedef struct
 {
-	long		a, b;			/* a fractional number */
+	long		a, b;			/* a fractional number (kept in lowest form, with b > 0) */
 } fnum;
 
+typedef unsigned __int128	wide;	/* the intermediate results of fraction arithmetic, before they're checked to fit a long */
+
+typedef struct
+{
+	char		*text;			/* some formatted output */
+	long		length, size;	/* how much there is, and how much room */
+} BufferRec, *BufferPtr;
+
+typedef struct
+{
+	long		*values;		/* some weights, each as \lambda_0, ..., \lambda_n, h (or, when estimating, k_n, k_{n-1} and a count) */
+	long		length, size;	/* how many values there are, and how much room */
+	char		failed;			/* did we run out of memory? */
+} ResultsRec, *ResultsPtr;
+
 typedef struct
 {
+	long		n;				/* the dimension of the weights */
+	FILE		*listing;		/* where to list them (the screen, a file, or 0 for nowhere) */
 	FILE		*file;			/* the output file (if any) */
+	char		format;			/* and its format */
+	long		*queue;			/* the weights waiting to be written, each as \lambda_0, ..., \lambda_n, h */
+	long		head, tail;		/* the next weight to write, and the next free slot (only the writer moves head) */
+	long		flushed;		/* the weights before this have all been written out */
+	char		done;			/* has the search finished? */
+	char		threaded;		/* is there a writer thread, or do we write the weights as they come? */
+	pthread_t	writer;
+	BufferRec	screen, text;	/* the output formatted so far */
+} SinkRec, *SinkPtr;
+
+typedef struct
+{
+	unsigned long	inverse;	/* a quick test of whether k divides \kappa: the inverse of the odd part of k (mod 2^64) */
+	unsigned long	limit;		/* (2^64 - 1) / k */
+	int				shift;		/* and the power of 2 in k */
+} DivisibilityRec, *DivisibilityPtr;
+
+typedef struct
+{
+	long		h;				/* a cached list of the divisors of h */
+	long		*divisors;		/* in increasing order */
+	long		numDivisors;
+} DivisorsRec, *DivisorsPtr;
+
+typedef struct
+{
+	DivisorsPtr	divisorCache;	/* the divisors of recent values of h, by h mod kDivisorCacheSize */
+	long		*primes,		/* the primes below primeLimit (for factorising h) */
+				numPrimes, primeLimit;
+} CacheRec, *CachePtr;
+
+typedef struct
+{
+	long		h, lam, max2;	/* a terminal leaf for which no \lambda_0, \lambda_1, \lambda_2 pass the divisibility and size tests */
+} MemoRec, *MemoPtr;
+
+typedef struct
+{
+	char		*name;			/* the file the position of the search is saved to */
+	long		interval;		/* how often to save it (in seconds) */
+	time_t		due;			/* and when it's next due */
+	long		n;				/* a saved position: the dimension, and the type of singularities */
+	char		terminal;
+	long		level;			/* the level at which the search picks up again */
+	long		*k;				/* and the k-values k_level, ..., k_n it picks up from */
+	long		numFound;		/* the number of weights found before it */
+	char		overflow;		/* was part of the search before it skipped? */
+	char		format;			/* the format of the output file */
+	long		offset;			/* and how much of it had been written (or -1 if there isn't one) */
+} CheckpointRec, *CheckpointPtr;
+
+#ifdef kInstrument
+typedef struct
+{
+	long		nodes;			/* the nodes of the search visited at a level */
+	long		fullSums;		/* rejected: the reciprocals of the k-values above already add up to 1 */
+	long		overflows;		/* rejected: the upper bound didn't fit a long */
+	long		emptyBound;		/* rejected: the range given by the fractional upper bound was empty */
+	long		emptyTightened;	/* rejected: tightening the upper bound emptied the range */
+	long		terminalRule;	/* the times the terminal \lambda_n <= n-1 rule was applied */
+	long		widthBound;		/* the total width of the ranges given by the fractional upper bound */
+	long		widthTightened;	/* and after tightening */
+	long		kappaSteps;		/* the \kappa scanned while tightening */
+	double		time;			/* the time spent in the subtrees at this level (in seconds) */
+	double		tightenTime;	/* and tightening the upper bounds */
+} LevelStatsRec, *LevelStatsPtr;
+
+typedef struct
+{
+	LevelStatsPtr	levels;		/* the statistics for each level of the search */
+	long		leaves;			/* the leaves reached (calls to doFinishCalculation*) */
+	long		smallLambda;	/* rejected at a leaf: \lambda_0 (or \lambda_0 + \lambda_1 + \lambda_2) too small */
+	long		lambdaNotDivisor;	/* rejected: \lambda_0 doesn't divide h (canonical) */
+	long		largeLambda;	/* rejected: \lambda_0 too large (canonical) */
+	long		triples;		/* the \lambda_0, \lambda_1, \lambda_2 tried (terminal) */
+	long		smallKValues;	/* rejected: k_0, k_1 or k_2 too small (terminal) */
+	long		sumChecks;		/* calls to doCheckSumValid */
+	long		sumFailures;	/* and how many failed */
+	long		events;			/* the \kappa they stopped at */
+	double		sumTime;		/* and the time spent in them */
+} StatsRec, *StatsPtr;
+#endif
+
+typedef struct	PoolRec	PoolRec, *PoolPtr;
+
+typedef struct
+{
+	SinkPtr		sink;			/* where to write the weights (or 0 if we're only counting them) */
 	char		terminal;		/* are we restricting ourselves to terminal singularities or not? */
 	long		n;				/* the dimension we're working in */
 	long		*k;				/* the array of k-values */
+	long		*lowers, *uppers;	/* the range each k-value is stepping through */
+	fnum		*sums;			/* sums[i] = 1/k_{i+1} + ... + 1/k_n, in lowest form */
+	long		*lcms;			/* lcms[i] = lcm( k_{i+1}, ..., k_n ) */
+	unsigned char	*multiples;	/* multiples[kappa] = how many of the k-values fixed so far divide kappa (if any) */
+	long		numMultiples;	/* the size of the multiples table */
+	long		*nextMultiple;	/* the next multiple of each k-value (when checking the sums) */
+	DivisibilityPtr	tests;		/* the divisibility tests for the k-values (when counting multiples directly) */
+	long		numFound;		/* the number of weights found */
+	long		nodes;			/* the number of nodes of the search visited */
+	CachePtr	cache;			/* the primes and divisors found so far (which may be shared with other weights) */
+	char		ownsCache;		/* is the cache ours to dispose of? */
+	char		overflow;		/* did any of the numbers outgrow a long (so that part of the search was skipped)? */
+	MemoPtr		memo;			/* the failed terminal leaves (if we're remembering them) */
+	long		memoSize,		/* the size of the memo table (a power of 2) */
+				memoHits,		/* how many leaves it let us skip */
+				memoMisses;		/* and how many we had to search */
+	long		splitAt;		/* the level at which to hand the search out as tasks (or kNoSplit) */
+	PoolPtr		pool;			/* the pool the tasks belong to (parallel runs only) */
+	ResultsPtr	results;		/* where to collect the weights, rather than writing them (parallel runs only) */
+	CheckpointPtr	checkpoint;	/* where to save the position of the search (if anywhere) */
+	long		resumeLevel;	/* while resuming a search, the level at which it picks up again (or 0) */
+	long		*resumeAt;		/* and the k-values it picks up from */
+	long		*sliceFrom, *sliceTo;	/* the slice of the search we're confined to: the k-values between these (in order) */
+	long		sliceLevel;		/* the lowest level the slice constrains (or n + 1, if there's no slice) */
+	ResultsPtr	tallies;		/* the subtrees below each (k_n, k_{n-1}) (when estimating the cost of the slices) */
+#ifdef kInstrument
+	StatsPtr	stats;			/* the statistics on the search (if we're collecting them) */
+#endif
 } WeightRec, *WeightPtr;
 
+typedef struct
+{
+	long		*k;				/* a task: the k-values k_{splitAt+1}, ..., k_n fixed above it */
+	long		*lowers, *uppers;	/* and the ranges they were stepping through */
+	ResultsRec	results;		/* the weights found in its subtree */
+	long		numFound;		/* and how many there were */
+	char		overflow;		/* was part of its subtree skipped? */
+	char		resume;			/* does the search pick up again part way through its subtree? */
+	char		done;			/* has it been searched? */
+} TaskRec, *TaskPtr;
+
+typedef struct
+{
+	long			next, end;	/* a thread's share of the tasks still to do */
+	pthread_mutex_t	lock;
+} DequeRec, *DequePtr;
+
+struct PoolRec
+{
+	TaskPtr			tasks;		/* the tasks, in the order the serial search would reach them */
+	long			numTasks,
+					maxTasks;
+	long			level;		/* the level of the search the tasks start from */
+	char			failed;		/* did we run out of memory splitting the search? */
+	long			numThreads;	/* the number of threads */
+	DequePtr		deques;		/* their shares of the tasks */
+	WeightPtr		*workers;	/* and their weights */
+	long			nextToEmit;	/* the first task whose output hasn't been written */
+	long			numFound;	/* the number of weights in the tasks before it */
+	char			overflow;	/* was part of any of those tasks skipped? */
+	WeightPtr		weight;		/* the weight being searched */
+	SinkPtr			sink;		/* where the weights are written (if anywhere) */
+	pthread_mutex_t	emitLock;
+};
+
+typedef struct
+{
+	PoolPtr		pool;			/* a thread: its pool */
+	long		index;			/* and which thread it is */
+} WorkerRec, *WorkerPtr;
+
+typedef struct
+{
+	long		n;				/* a batch job: the dimension */
+	char		terminal;		/* and the type of singularities */
+	char		failed;			/* did it fail to start? */
+	char		overflow;		/* was part of its search skipped? */
+	long		numFound;		/* the number of weights it found */
+} JobRec, *JobPtr;
+
+typedef struct
+{
+	JobPtr			jobs;		/* the jobs, in the order given */
+	long			numJobs,
+					nextJob;	/* the first job not yet started */
+	char			quiet;		/* should the jobs only count their weights? */
+	char			saveFile;	/* should each job also write an output file? */
+	char			format;		/* and in which format */
+	long			memoBytes;	/* the size of each job's memo table (if any) */
+	pthread_mutex_t	lock;
+} BatchRec, *BatchPtr;
+
 /* function prototypes */
-int					main							( void );
-static FILE	 *		doAppInit						( long *, char * );
+int					main							( int, char ** );
+static FILE	 *		doAppInit						( long *, char *, char, char );
 static void			doAddWeightToList				( WeightPtr, long );
-static FILE *		doCreateOutputFile				( long, char );
-static void			doCloseOutputFile				( FILE * );
-static WeightPtr	doNewWeight						( long, char );
+static void			doAddProjectiveSpace			( WeightPtr );
+static SinkPtr		doNewSink						( long, FILE *, FILE *, char );
+static void			doDisposeSink					( SinkPtr );
+static long *		doReserveResult					( SinkPtr );
+static void			doCommitResult					( SinkPtr );
+static void *		doSinkThread					( void * );
+static long			doDrainSink						( SinkPtr );
+static void			doFormatResult					( SinkPtr, long * );
+static void			doFlushSink						( SinkPtr );
+static void			doSyncSink						( SinkPtr );
+static void			doSaveCheckpoint				( WeightPtr, long, long *, long *, long *, long, char );
+static char			doLoadCheckpoint				( CheckpointPtr );
+static double		doEstimateProgress				( long, long, long *, long *, long * );
+static char			doRunParallel					( WeightPtr, long, long );
+static void			doAddTask						( WeightPtr );
+static void *		doWorkerThread					( void * );
+static long			doTakeTask						( PoolPtr, long );
+static void			doEmitTasks						( PoolPtr, long );
+static void			doDisposePool					( PoolPtr );
+static char			doReadBatch						( BatchPtr, char * );
+static void			doRunBatch						( BatchPtr, long );
+static void *		doBatchThread					( void * );
+static void			doRunJob						( BatchPtr, JobPtr, CachePtr );
+static char			doReadSlice						( WeightPtr, char * );
+MInline char		doOnSliceEdge					( WeightPtr, long, long * );
+static char			doInSlice						( WeightPtr );
+static void			doTally							( WeightPtr );
+static void			doEstimateSlices				( long, char, long, long );
+static char			doMergeSlices					( char **, long, char, char );
+static int			doCompareWeights				( const void *, const void * );
+static char			doRunTest						( char * );
+static char			doTestWeight					( WeightPtr, long * );
+static FILE *		doCreateOutputFile				( long, char, char );
+static FILE *		doReopenOutputFile				( long, char, char, long );
+static void			doOutputFileName				( char *, long, char, char );
+static void			doCloseOutputFile				( FILE *, char );
+static WeightPtr	doNewWeight						( long, char, CachePtr, SinkPtr );
 static void			doDisposeWeight					( WeightPtr );
+static char			doNewState						( WeightPtr );
+static void			doResetState					( WeightPtr, long );
+static void			doAddMultiples					( WeightPtr, long, long );
+static char			doGrowMultiples					( WeightPtr, long, long );
 static void			doCalculatek					( WeightPtr, long );
 static long			doTightenUpper					( WeightPtr, long, long );
+static void			doNewDivisibilityTest			( DivisibilityPtr, long );
+static void			doCountMultiples				( DivisibilityPtr, long, long, long * );
+static char			doRunCheck						( char * );
+static unsigned long	doFingerprint					( long *, long, long );
 static void			doFinishCalculationCanonical	( WeightPtr );
 static void			doFinishCalculationTerminal		( WeightPtr );
 static void			doCalculate3Lambdas				( WeightPtr, long, long );
+static char			doNewMemo						( WeightPtr, long );
+static MemoPtr		doFindMemo						( WeightPtr, long, long, long );
+static DivisorsPtr	doFindDivisors					( CachePtr, long );
+static char			doGrowPrimes					( CachePtr, long );
+static CachePtr		doNewCache						( void );
+static void			doDisposeCache					( CachePtr );
+static long			doPrevDivisor					( DivisorsPtr, long, long );
+static int			doCompareLongs					( const void *, const void * );
 static char			doCheckSumValid					( WeightPtr, long );
-static void			doLowestForm					( fnum * );
+MInline char		doCheckKappa					( WeightPtr, long, long, long, long );
+static char			doAddFraction					( fnum *, fnum *, long, long );
 static long			doFindHCF						( long, long );
-static long			doFindLCM						( long, long );
-static long			doNextPrime						( long );
+static wide			doFindWideHCF					( wide, wide );
+static char			doFindLCM						( long, long, long * );
+MInline char		doCheckSum						( WeightPtr, long );
+#ifdef kInstrument
+static char			doNewStats						( WeightPtr );
+static void			doMergeStats					( StatsPtr, StatsPtr, long );
+static void			doWriteStats					( WeightPtr, char * );
+static double		doNow							( void );
+#endif
 
 /* main -	the program entry/exit point */
-int main( void )
+/*	The search can be split between threads with "-threads t", the subtrees below the first d levels of k-values
+	("-depth d", by default 2) being handed out as tasks. The output is the same, in the same order.
+	Alternatively "-batch 5n,6y,7y" runs each of the given dimensions in turn without asking any questions, 'y' or
+	'n' saying whether to limit to terminal singularities. Each job lists its weights to its own file (and, with
+	"-latex", writes its own LaTeX file too), and "-threads t" then runs up to t jobs at a time.
+	The output file can be written as a CSV file or a binary file instead with "-format csv" or "-format binary",
+	and "-quiet" leaves out the list of weights, just counting them.
+	With "-checkpoint file" the position of the search is saved to the file every ten minutes (or every s seconds,
+	with "-interval s"), along with a report of how far it's got; "-resume" then picks the search up from there,
+	adding to the output file where it left off.
+	"-slice from:to file" searches only the part of the search from one list of k-values (k_n, k_{n-1}, ...) to
+	another, in the order the search takes them (either end may be left out, or cut short, as in "-slice 5:7,20"),
+	and saves the weights to the file. "-prefix k_n,k_{n-1},..." lists only the weights that start with the given
+	k-values (a slice may be given here too). "-test l_0,...,l_n" checks a single weight.
+	"-merge file file ..." merges the weights saved from the slices (up to the next option), in the output format. "-estimate s" proposes
+	s slices that ought to take about as long as each other. None asks whether to save the output.
+	"-check [file]" runs the searches that finish quickly and compares the weights found against those known to be
+	right, writing the times to the file (as JSON) if one is given.
+	A build compiled with -DkInstrument also takes "-stats file", which writes statistics on the search to the file.	*/
+int main( int argc, char **argv )
 {
 	WeightPtr		w = kFalse;
-	long			n;
-	char			terminal;
+	SinkPtr			sink = kFalse;
+	CheckpointRec	checkpoint;
+	long			n, numThreads = 1, depth = 0, memoBytes = 0;
+	char			terminal, *jobList = kFalse, saveFile = kFalse, format = kFormatTeX, quiet = kFalse, resume = kFalse;
+	char			*sliceName = kFalse, *sliceSpec = kFalse;
+	long			numSlices = 0, numMerge = 0, header[2];
+	char			**mergeNames = kFalse;
 	FILE			*file;
+	int				i;
+#ifdef kInstrument
+	char			*statsName = kFalse;
+#endif
 	
-	/* initialize the application */
-	file = doAppInit( &n, &terminal );
+	memset( (void *)&checkpoint, 0, sizeof( CheckpointRec ) );
+	checkpoint.interval = kCheckpointInterval;
 	
-	/* allocate the memory */
-	if( !(w = doNewWeight( n, terminal )) )
+	/* read the command line */
+	for( i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-threads" ) && (i + 1 < argc) )
+			numThreads = atol( argv[++i] );
+		else if( !strcmp( argv[i], "-depth" ) && (i + 1 < argc) )
+			depth = atol( argv[++i] );
+		else if( !strcmp( argv[i], "-memo" ) && (i + 1 < argc) )
+			memoBytes = atol( argv[++i] ) * 1048576L;
+		else if( !strcmp( argv[i], "-batch" ) && (i + 1 < argc) )
+			jobList = argv[++i];
+		else if( !strcmp( argv[i], "-latex" ) )
+			saveFile = kTrue;
+		else if( !strcmp( argv[i], "-format" ) && (i + 1 < argc) && (!strcmp( argv[i + 1], "tex" )
+				|| !strcmp( argv[i + 1], "csv" ) || !strcmp( argv[i + 1], "binary" )) )
+		{
+			i++;
+			saveFile = kTrue;
+			if( argv[i][0] == 't' )			format = kFormatTeX;
+			else if( argv[i][0] == 'c' )	format = kFormatCSV;
+			else							format = kFormatBinary;
+		}
+		else if( !strcmp( argv[i], "-quiet" ) )
+			quiet = kTrue;
+		else if( !strcmp( argv[i], "-checkpoint" ) && (i + 1 < argc) )
+			checkpoint.name = argv[++i];
+		else if( !strcmp( argv[i], "-interval" ) && (i + 1 < argc) )
+			checkpoint.interval = atol( argv[++i] );
+		else if( !strcmp( argv[i], "-resume" ) )
+			resume = kTrue;
+		else if( !strcmp( argv[i], "-slice" ) && (i + 2 < argc) )
+		{
+			sliceSpec = argv[++i];
+			sliceName = argv[++i];
+		}
+		else if( !strcmp( argv[i], "-prefix" ) && (i + 1 < argc) )
+			sliceSpec = argv[++i];
+		else if( !strcmp( argv[i], "-test" ) && (i + 1 < argc) )
+			return( doRunTest( argv[i + 1] ) );
+		else if( !strcmp( argv[i], "-estimate" ) && (i + 1 < argc) )
+			numSlices = atol( argv[++i] );
+		else if( !strcmp( argv[i], "-merge" ) && (i + 1 < argc) && (argv[i + 1][0] != '-') )
+		{	/* (the files run up to the next option) */
+			mergeNames = argv + i + 1;
+			for( numMerge = 0; (i + 1 < argc) && (argv[i + 1][0] != '-'); i++ )
+				numMerge++;
+		}
+#ifdef kInstrument
+		else if( !strcmp( argv[i], "-stats" ) && (i + 1 < argc) )
+			statsName = argv[++i];
+#endif
+		else if( !strcmp( argv[i], "-check" ) )
+			return( doRunCheck( (i + 1 < argc) && (argv[i + 1][0] != '-') ? argv[i + 1] : kFalse ) ? EXIT_SUCCESS : EXIT_FAILURE );
+		else
+		{
+			printf( "Usage: %s [-threads t] [-depth d] [-memo megabytes] [-format tex|csv|binary] [-quiet] [-checkpoint file [-interval s] [-resume]] [-batch 5n,6y,... [-latex]] [-slice from:to file] [-prefix k_n,...] [-merge file ...] [-estimate s] [-test l_0,...,l_n] [-check [file]]\n", argv[0] );
+			return( kFalse );
+		}
+	}
+	if( mergeNames )
+		return( doMergeSlices( mergeNames, numMerge, format, quiet ) );
+	if( numSlices )
+	{	/* (the estimate is made to its own depth, unless one is given) */
+		if( numSlices < 1 )
+		{
+			printf( "The number of slices must be at least 1!\n" );
+			return( kFalse );
+		}
+		doAppInit( &n, &terminal, format, kFalse );
+		doEstimateSlices( n, terminal, numSlices, depth ? depth : kEstimateDepth );
+		return( kTrue );
+	}
+	if( !depth )	depth = 2;
+	if( (numThreads < 1) || (numThreads > kMaxThreads) || (depth < 1) || (memoBytes < 0) || (checkpoint.interval < 1) )
+	{
+		printf( "The number of threads must be between 1 and %d, the depth and interval at least 1, and the memo size at least 0!\n", kMaxThreads );
+		return( kFalse );
+	}
+	if( (resume && !checkpoint.name) || ((jobList || sliceSpec) && checkpoint.name) || (jobList && sliceSpec) )
+	{
+		printf( "A search can only be resumed from a checkpoint file, a batch or a slice can't be checkpointed, and a batch\ncan't be sliced!\n" );
 		return( kFalse );
-	w->file = file;
+	}
+#ifdef kInstrument
+	if( jobList && statsName )
+	{
+		printf( "Statistics are only collected for a single search, not a batch!\n" );
+		return( kFalse );
+	}
+#endif
 	
-	/* start the calculation */
-	doCalculatek( w, w->n );
+	/* a batch of jobs is run without asking any questions */
+	if( jobList )
+	{
+		BatchRec		batch;
+		
+		memset( (void *)&batch, 0, sizeof( BatchRec ) );
+		batch.quiet = quiet;
+		batch.saveFile = saveFile;
+		batch.format = format;
+		if( !doReadBatch( &batch, jobList ) )
+		{
+			free( (void *)batch.jobs );
+			return( kFalse );
+		}
+		if( numThreads > batch.numJobs )	numThreads = batch.numJobs;
+		batch.memoBytes = memoBytes / numThreads;
+		doRunBatch( &batch, numThreads );
+		free( (void *)batch.jobs );
+		printf( "\nFinished.\n" );
+		return( kTrue );
+	}
+	
+	/* initialize the application (or, if we're resuming a search, read where it had got to) */
+	if( sliceName )
+	{	/* a slice saves its weights to its own file, in binary, after n and whether it's terminal */
+		doAppInit( &n, &terminal, format, kFalse );
+		format = kFormatBinary;
+		if( !(file = fopen( sliceName, "wb" )) )
+		{
+			printf( "Error! Unable to create file '%s'.\n", sliceName );
+			return( kFalse );
+		}
+		header[0] = n;
+		header[1] = terminal;
+		fwrite( (void *)header, sizeof( long ), 2, file );
+	}
+	else if( !resume )
+		file = doAppInit( &n, &terminal, format, kTrue );
+	else
+	{
+		file = kFalse;
+		if( !doLoadCheckpoint( &checkpoint ) || ((checkpoint.offset >= 0)
+			&& !(file = doReopenOutputFile( checkpoint.n, checkpoint.terminal, checkpoint.format, checkpoint.offset ))) )
+		{
+			free( (void *)checkpoint.k );
+			return( kFalse );
+		}
+		n = checkpoint.n;
+		terminal = checkpoint.terminal;
+		format = checkpoint.format;
+		printf( "Resuming the search in dimension %ld, after %ld weights.\n\n", n, checkpoint.numFound );
+	}
+	
+	/* allocate the memory, and start the writer (unless there's nothing to write) */
+	if( (file || !quiet) && !(sink = doNewSink( n, quiet ? kFalse : stdout, file, format )) )
+	{
+		if( file )	doCloseOutputFile( file, format );
+		free( (void *)checkpoint.k );
+		return( kFalse );
+	}
+	if( !(w = doNewWeight( n, terminal, kFalse, (resume || sliceSpec) ? kFalse : sink )) )
+	{
+		doDisposeSink( sink );
+		free( (void *)checkpoint.k );
+		return( kFalse );
+	}
+	w->sink = sink;
+	if( sliceSpec )
+	{	/* (P^n is listed only if it's in the slice) */
+		if( !doReadSlice( w, sliceSpec ) )
+		{
+			doDisposeWeight( w );
+			doDisposeSink( sink );
+			if( sliceName )		remove( sliceName );
+			return( kFalse );
+		}
+		if( terminal )
+		{
+			w->numFound = 0;
+			for( i = 0; i <= n; i++ )	w->k[i] = n + 1;
+			if( doInSlice( w ) )	doAddProjectiveSpace( w );
+			for( i = 0; i <= n; i++ )	w->k[i] = 0;
+		}
+	}
+	if( checkpoint.name )
+	{	/* (when resuming, P^n was among the weights already found) */
+		w->checkpoint = &checkpoint;
+		checkpoint.due = time( NULL ) + checkpoint.interval;
+		if( resume )
+		{
+			w->numFound = checkpoint.numFound;
+			w->overflow = checkpoint.overflow;
+			w->resumeLevel = checkpoint.level;
+			w->resumeAt = checkpoint.k;
+		}
+	}
+	if( memoBytes && !doNewMemo( w, memoBytes / (long)sizeof( MemoRec ) ) )
+		printf( "Not enough memory for the memo table; continuing without it.\n" );
+#ifdef kInstrument
+	if( statsName && !doNewStats( w ) )
+		printf( "Not enough memory for the statistics; continuing without them.\n" );
+#endif
+	
+	/* start the calculation (in this thread alone if the parallel run can't be set up) */
+	if( (numThreads == 1) || !doRunParallel( w, numThreads, depth ) )
+	{
+		w->resumeLevel = resume ? checkpoint.level : 0;		/* (the parallel run may have started resuming) */
+		MTimed( w, w->stats->levels[w->n].time, doCalculatek( w, w->n ) );
+	}
+	doDisposeSink( sink );
+#ifdef kInstrument
+	if( w->stats )
+		doWriteStats( w, statsName );
+#endif
+	if( checkpoint.name )
+		remove( checkpoint.name );
+	free( (void *)checkpoint.k );
+	if( quiet )
+		printf( "%ld weights found.\n", w->numFound );
+	if( w->overflow )
+		printf( "\nWarning! Some of the numbers were too large to hold, so part of the search was skipped;\nthe list above may not be complete.\n" );
+	if( w->memo )
+		printf( "\nMemo table: %ld entries, %ld hits, %ld misses.\n", w->memoSize, w->memoHits, w->memoMisses );
 	
 	/* free the memory */
 	doDisposeWeight( w );
@@ -80,9 +601,10 @@ int main( void )
 	return( kTrue );
 }
 
-/* doAppInit -	call to initialize the application */
-static FILE *doAppInit( long *n, char *terminal )
+/* doAppInit -	call to initialize the application (asking whether to save the output, if we're to) */
+static FILE *doAppInit( long *n, char *terminal, char format, char askFile )
 {	
+	static const char	*formatNames[] = { "LaTeX", "CSV", "binary" };
 	int		temp;
 	char		str[60];
 	FILE		*file = kFalse;
@@ -105,10 +627,13 @@ static FILE *doAppInit( long *n, char *terminal )
 	if( str[0] == 'y' )	*terminal = kTrue;
 	else				*terminal = kFalse;
 	
-	/* shall we save the output to a LaTeX file or not? */
-	printf( "Output results to LaTeX file? (y/n) " );
-	scanf( "%s", str );
-	if( str[0] == 'y' )	file = doCreateOutputFile( *n, *terminal );
+	/* shall we save the output to a file or not? */
+	if( askFile )
+	{
+		printf( "Output results to %s file? (y/n) ", formatNames[(int)format] );
+		scanf( "%s", str );
+		if( str[0] == 'y' )	file = doCreateOutputFile( *n, *terminal, format );
+	}
 	
 	/* leave a blank line */
 	printf( "\n" );
@@ -119,251 +644,1616 @@ static FILE *doAppInit( long *n, char *terminal )
 /* doAddWeightToList -call to add the given weight to the list we're maintaining */
 static void doAddWeightToList( WeightPtr w, long h )
 {
-	long		i;
+	ResultsPtr	results = w->results;
+	long		i, *result;
 	
-	/* output the \lambda_i to the screen */
-	for( i = 0; i <= w->n; i++ )		printf( "%d, ", h / w->k[i] );
-	printf( "h=%d\n", h );
+	w->numFound++;
 	
-	/* output the \lambda_i to the file */
-	if( w->file )
+	/* find a place for the \lambda_i: collected for later in a parallel run, or else straight to the writer */
+	if( results )
 	{
-		for( i = 0; i <= w->n; i++ )	fprintf( w->file, "$%d$&", h / w->k[i] );
-		fprintf( w->file, "$%d$\\\\\n", h );
+		if( results->failed )
+			return;
+		if( results->length + w->n + 2 > results->size )
+		{
+			long		size = results->size ? 2 * results->size : 64 * (w->n + 2);
+			long		*values;
+			
+			if( !(values = (long *)realloc( (void *)results->values, sizeof( long ) * size )) )
+			{
+				results->failed = kTrue;
+				return;
+			}
+			results->values = values;
+			results->size = size;
+		}
+		result = results->values + results->length;
+		results->length += w->n + 2;
 	}
-}
-
-/* doCreateOutputFile -	call to create a LaTeX output file, and write the headers */
-static FILE *doCreateOutputFile( long n, char terminal )
-{
-	char		name[25];
-	FILE		*file;
-	
-	/* create the file name */
-	if( terminal )	sprintf( name, "dim_%d_term.tex", n );
-	else			sprintf( name, "dim_%d_canon.tex", n );
-	
-	/* create the file */
-	if( !(file = fopen( name, "w" )) )
-		printf( "Error! Unable to create file '%s'.\n", name );
+	else if( w->sink )
+		result = doReserveResult( w->sink );
 	else
-	{	/* write the file headers */
-		long		i;
-		
-		if( terminal )	fprintf( file, "$n=%d$; terminal singularities.\n\n\\begin{tabular}{|", n );
-		else			fprintf( file, "$n=%d$; canonical singularities.\n\n\\begin{tabular}{|", n );
-		for( i = 0; i <= n; i++ )	fprintf( file, "c" );
-		fprintf( file, "|c|}\n\\hline\n" );
-		for( i = 0; i <= n; i++ )	fprintf( file, "$\\lambda_%d$&", i );
-		fprintf( file, "$h$\\\\\n\\hline\n" );
-	}
+		return;
 	
-	return( file );
+	/* and record them */
+	for( i = 0; i <= w->n; i++ )		result[i] = h / w->k[i];
+	result[w->n + 1] = h;
+	if( !results )
+		doCommitResult( w->sink );
 }
 
-/* doCloseOutputFile -	call to close the output LaTeX file */
-static void doCloseOutputFile( FILE *file )
+/* doAddProjectiveSpace -	call to add P^n (whose k-values are all n + 1) to the list */
+/*	P^n is counted and listed on the screen, but (as it always has been) left out of the output file; the writer
+	hasn't been handed anything yet, so we can list it ourselves.	*/
+static void doAddProjectiveSpace( WeightPtr w )
 {
-	/* write the footers */
-	fprintf( file, "\\hline\n\\end{tabular}\n" );
+	long		i;
 	
-	/* finally, close the file */
-	fclose( file );
+	w->numFound++;
+	if( w->results || !w->sink || !w->sink->listing )
+		return;
+	for( i = 0; i <= w->n; i++ )	fprintf( w->sink->listing, "1, " );
+	fprintf( w->sink->listing, "h=%ld\n", w->n + 1 );
 }
 
-/* doNewWeight -	call to allocate the memory for a new weight of dimension n */
-static WeightPtr doNewWeight( long n, char terminal )
+/* doNewSink -	call to start a writer listing weights of dimension n to the given file (if any), and saving them to another */
+/*	The search hands each weight to the writer through a queue, and carries on; the writer thread formats them into
+	large buffers and writes those out, so that the search spends no time on output. The queue has a single writer
+	and a single reader, who each move their own end of it, so it needs no lock. If the thread can't be started we
+	write the weights as they come instead.	*/
+static SinkPtr doNewSink( long n, FILE *listing, FILE *file, char format )
 {
-	WeightPtr	w = kFalse;
-	long		i;
-	
-	/* check the dimension is valid */
-	if( n < 2 )
-	{
-		printf( "The dimension must be greater than 1! (You have entered %d.)\n", n );
-		return( kFalse );
-	}
-	else if( (n < 3) && terminal )
-	{
-		printf( "In the terminal case, the dimension must be greater than 2! (You have entered 2.)\n" );
-		return( kFalse );
-	}
+	SinkPtr		s;
 	
-	/* allocate the memory for the weight */
-	if( !(w = (WeightPtr)malloc( sizeof( WeightRec ) )) )
+	/* allocate the memory */
+	if( !(s = (SinkPtr)calloc( 1, sizeof( SinkRec ) )) || !(s->queue = (long *)malloc( sizeof( long ) * kQueueSize * (n + 2) ))
+		|| !(s->screen.text = (char *)malloc( kFlushSize + 32 * (n + 2) ))
+		|| !(s->text.text = (char *)malloc( kFlushSize + 32 * (n + 2) )) )
 	{
-		printf( "Not enough memory to create the weight structure!\n" );
+		printf( "Not enough memory to create the output buffers!\n" );
+		if( s )
+		{
+			free( (void *)s->queue );
+			free( (void *)s->screen.text );
+			free( (void *)s );
+		}
 		return( kFalse );
 	}
+	s->n = n;
+	s->listing = listing;
+	s->file = file;
+	s->format = format;
+	s->screen.size = s->text.size = kFlushSize;
 	
-	/* allocate the memory for the k-value array */
-	if( !(w->k = (long *)malloc( sizeof( long ) * (n + 1) )) )
-	{
-		free( (void *)w );
-		printf( "Not enough memory to create a k array!\n" );
-		return( kFalse );
-	}
+	/* and start the writer */
+	s->threaded = !pthread_create( &s->writer, NULL, doSinkThread, (void *)s );
 	
-	/* set the dimension and singularity type, and set the file pointer to 0 */
-	w->terminal = terminal;
-	w->n = n;
-	w->file = kFalse;
+	return( s );
+}
+
+/* doDisposeSink -	call to write out any weights still waiting, stop the writer, and close the output file */
+static void doDisposeSink( SinkPtr s )
+{
+	if( !s )
+		return;
 	
-	/* if we're in the terminal case, add P^n by hand, since we use sharp bounds which assume that \lambda_n > 1. */
-	if( terminal )
+	/* let the writer finish the queue */
+	if( s->threaded )
 	{
-		for( i = 0; i <= n; i++ )	w->k[i] = n + 1;
-		doAddWeightToList( w, n + 1 );
+		__atomic_store_n( &s->done, kTrue, __ATOMIC_RELEASE );
+		pthread_join( s->writer, NULL );
 	}
+	doDrainSink( s );
+	doFlushSink( s );
 	
-	/* finally, zero the array; we're ready to begin */
-	for( i = 0; i <= n; i++ )	w->k[i] = 0;
-	
-	return( w );
+	/* close the file, and free the memory */
+	if( s->file )	doCloseOutputFile( s->file, s->format );
+	free( (void *)s->queue );
+	free( (void *)s->screen.text );
+	free( (void *)s->text.text );
+	free( (void *)s );
 }
+
+/* doReserveResult -	call to find the next free slot in the queue, waiting for the writer if it's full */
+static long *doReserveResult( SinkPtr s )
+{
+	while( s->tail - __atomic_load_n( &s->head, __ATOMIC_ACQUIRE ) == kQueueSize )
+		sched_yield();
 	
-/* doDisposeWeight -	call to free the memory of a weight */
-static void doDisposeWeight( WeightPtr w )
+	return( s->queue + (s->tail % kQueueSize) * (s->n + 2) );
+}
+
+/* doCommitResult -	call to hand the weight in the reserved slot to the writer */
+static void doCommitResult( SinkPtr s )
 {
-	/* check that we actually have a weight before we try to dispose of it */
-	if( w )
-	{
-		/* dispose of the k-array */
-		if( w->k )		free( (void *)w->k );
-		
-		/* close any open files */
-		if( w->file )	doCloseOutputFile( w->file );
-		
-		/* dispose of the weight */
-		free( (void *)w );
-	}
+	__atomic_store_n( &s->tail, s->tail + 1, __ATOMIC_RELEASE );
+	if( !s->threaded )
+		doDrainSink( s );
 }
 
-/* doCalculatek -	calculates recursively the possible k-values */
-static void doCalculatek( WeightPtr w, long i )
+/* doSinkThread -	call to write out the weights in the queue as they arrive, until the search has finished */
+static void *doSinkThread( void *sink )
 {
-	long		lower, upper, j;
-	fnum		sum = {0,1}, temp;
+	SinkPtr				s = (SinkPtr)sink;
+	struct timespec		pause = { 0, 1000000 };
+	char				done;
 	
-	/* first check that we're not already calculated enough */
-	if( w->terminal && (i <= 2) )
-	{	/* terminal bound */
-		doFinishCalculationTerminal( w );
-		return;
-	}
-	else if( !w->terminal && !i )
-	{	/* canonical bound */
-		doFinishCalculationCanonical( w );
-		return;
+	for( ;; )
+	{
+		/* (the search has finished only if it had before we last looked at the queue) */
+		done = __atomic_load_n( &s->done, __ATOMIC_ACQUIRE );
+		if( !doDrainSink( s ) )
+		{
+			if( done )
+				break;
+			
+			/* nothing to do, so write out what we have and wait a little */
+			doFlushSink( s );
+			__atomic_store_n( &s->flushed, s->head, __ATOMIC_RELEASE );
+			nanosleep( &pause, NULL );
+		}
 	}
 	
-	/* otherwise, step through the possible values of k_i */
-	/* first establish the lower bounds */
-	lower = w->n-i+2;
-	if( w->terminal )	lower++;
-	if( (i < w->n) && (lower < w->k[i+1]) )	lower = w->k[i+1];
+	return( NULL );
+}
+
+/* doDrainSink -	call to format every weight waiting in the queue, returning how many there were */
+static long doDrainSink( SinkPtr s )
+{
+	long		head, first = s->head, tail = __atomic_load_n( &s->tail, __ATOMIC_ACQUIRE );
 	
-	/* now the upper bounds */
-	for( j = i + 1; j <= w->n; j++ )
+	for( head = first; head < tail; head++ )
 	{
-		sum.a = sum.a * w->k[j] + sum.b;
-		sum.b = sum.b * w->k[j];
-		doLowestForm( &sum );
+		doFormatResult( s, s->queue + (head % kQueueSize) * (s->n + 2) );
+		__atomic_store_n( &s->head, head + 1, __ATOMIC_RELEASE );
 	}
-	temp.a = (i + 1) * sum.b;
-	temp.b = sum.b - sum.a;
-	doLowestForm( &temp );
-	upper = temp.a / temp.b;
-			
-	/* is this range sensible? */
-	if( upper < lower )	return;
 	
-	/* now check whether the upper bound can be bettered by direct calculation */
-	if( i < w-> n )
-		upper = doTightenUpper( w, i, upper );
-	else if( w->terminal )	/* \lambda_n <= n-1 in the terminal case */
-		upper = w->n - 1;
+	return( tail - first );
+}
+
+/* doFormatResult -	call to add a weight to the formatted output, writing the buffers out once they're full */
+static void doFormatResult( SinkPtr s, long *result )
+{
+	long		i, n = s->n;
 	
-	/* is the range still sensible? */
-	if( upper < lower )	return;
+	if( (s->screen.length >= s->screen.size) || (s->text.length >= s->text.size) )
+		doFlushSink( s );
 	
-	/* iterate on this range */
-	for( j = lower; j <= upper; j++ )
+	/* the list of weights: \lambda_0, ..., \lambda_n, h= */
+	if( s->listing )
 	{
-		w->k[i] = j;
-		doCalculatek( w, i - 1 );
+		for( i = 0; i <= n; i++ )
+			s->screen.length += sprintf( s->screen.text + s->screen.length, "%ld, ", result[i] );
+		s->screen.length += sprintf( s->screen.text + s->screen.length, "h=%ld\n", result[n + 1] );
+	}
+	
+	/* and the output file, as a row of the table, a line of comma-separated values, or n + 2 longs */
+	if( !s->file )
+		return;
+	switch( s->format )
+	{
+		case kFormatTeX:
+			for( i = 0; i <= n; i++ )
+				s->text.length += sprintf( s->text.text + s->text.length, "$%ld$&", result[i] );
+			s->text.length += sprintf( s->text.text + s->text.length, "$%ld$\\\\\n", result[n + 1] );
+			break;
+		case kFormatCSV:
+			for( i = 0; i <= n; i++ )
+				s->text.length += sprintf( s->text.text + s->text.length, "%ld,", result[i] );
+			s->text.length += sprintf( s->text.text + s->text.length, "%ld\n", result[n + 1] );
+			break;
+		default:
+			memcpy( (void *)(s->text.text + s->text.length), (void *)result, sizeof( long ) * (n + 2) );
+			s->text.length += sizeof( long ) * (n + 2);
+			break;
 	}
 }
 
-/* doTightenUpper -	call to check whether the upper bound can be tightened by direct calculation of the sum */
-static long doTightenUpper( WeightPtr w, long i, long upper )
+/* doFlushSink -	call to write out the formatted output */
+static void doFlushSink( SinkPtr s )
 {
-	long		kappa, sum = 1;
-	
-	/* work through the \kappa */
-	for( kappa = 2; kappa <= upper - 1; kappa++ )
+	if( s->screen.length )
 	{
-		long		j;
-		
-		/* calculate the sum as it currently stands */
-		sum++;
-		for( j = i + 1; j <= w->n; j++ )
-			if( !(kappa % w->k[j]) )	sum--;
-		
-		/* check that the values are valid */
-		if( w->terminal )
-		{	/* the terminal case */
-			if( (kappa < upper - 2) && (sum > w->n - 1) )			upper = kappa + 2;
-			if( (kappa < upper - 3) && (sum > w->n - 2) )			upper = kappa + 3;
-			if( (sum < 2) && (kappa >= 2) && (kappa < upper - 2) )	upper = kappa + 2;
-		}
-		else
-		{	/* the canonical case */
-			if( (kappa < upper - 2) && ((sum > w->n) || !sum) )		upper = kappa + 2;
-		}
+		fwrite( (void *)s->screen.text, 1, s->screen.length, s->listing );
+		fflush( s->listing );
+		s->screen.length = 0;
+	}
+	if( s->text.length )
+	{
+		fwrite( (void *)s->text.text, 1, s->text.length, s->file );
+		fflush( s->file );
+		s->text.length = 0;
+	}
+}
+
+/* doSyncSink -	call to wait until every weight handed to the writer has been written out */
+static void doSyncSink( SinkPtr s )
+{
+	if( !s->threaded )
+		doFlushSink( s );
+	else
+		while( __atomic_load_n( &s->flushed, __ATOMIC_ACQUIRE ) != s->tail )
+			sched_yield();
+}
+
+/* doSaveCheckpoint -	call to save the position of the search, and report how far it's got */
+/*	The search picks up again at the given level with the given k-values (the subtrees before them have all been
+	searched, and their weights written out). The file is written under another name and then renamed, so that a
+	crash part way through leaves the last checkpoint as it was.	*/
+static void doSaveCheckpoint( WeightPtr w, long level, long *k, long *lowers, long *uppers, long numFound, char overflow )
+{
+	CheckpointPtr	c = w->checkpoint;
+	char			temp[FILENAME_MAX];
+	FILE			*file;
+	long			offset = -1, i;
+	double			done;
+	
+	/* make sure everything found so far has been written, and note how much of the output file that is */
+	if( w->sink )
+	{
+		doSyncSink( w->sink );
+		if( w->sink->file )		offset = ftell( w->sink->file );
+	}
+	
+	/* write the checkpoint */
+	snprintf( temp, FILENAME_MAX, "%s.tmp", c->name );
+	if( !(file = fopen( temp, "w" )) )
+		fprintf( stderr, "Error! Unable to create file '%s'.\n", temp );
+	else
+	{
+		fprintf( file, "n %ld terminal %d\nfound %ld overflow %d\nformat %d offset %ld\nlevel %ld\n", w->n, w->terminal,
+			numFound, overflow, w->sink ? w->sink->format : kFormatTeX, offset, level );
+		for( i = level; i <= w->n; i++ )
+			fprintf( file, "k %ld lower %ld upper %ld\n", k[i], lowers[i], uppers[i] );
+		if( fclose( file ) || rename( temp, c->name ) )
+			fprintf( stderr, "Error! Unable to save the checkpoint to '%s'.\n", c->name );
+	}
+	
+	/* and report how far we've got (the estimate stays near zero for most of a long search, so until it says
+	   something we leave it out) */
+	done = 100 * doEstimateProgress( w->n, level, k, lowers, uppers );
+	fprintf( stderr, "Checkpoint: k_%ld = %ld (of %ld to %ld); ", w->n, k[w->n], lowers[w->n], uppers[w->n] );
+	if( done >= 0.05 )	fprintf( stderr, "about %.1f%% of the search done, ", done );
+	fprintf( stderr, "%ld weights found so far.\n", numFound );
+	c->due = time( NULL ) + c->interval;
+}
+
+/* doLoadCheckpoint -	call to read the position of a search from its checkpoint file */
+static char doLoadCheckpoint( CheckpointPtr c )
+{
+	FILE		*file;
+	int			terminal, overflow, format;
+	long		i;
+	char		valid;
+	
+	if( !(file = fopen( c->name, "r" )) )
+	{
+		printf( "Error! Unable to open file '%s'.\n", c->name );
+		return( kFalse );
+	}
+	valid = (fscanf( file, " n %ld terminal %d found %ld overflow %d format %d offset %ld level %ld", &c->n, &terminal,
+		&c->numFound, &overflow, &format, &c->offset, &c->level ) == 7) && (c->n >= 2) && (c->level >= 1) && (c->level <= c->n)
+		&& (format >= kFormatTeX) && (format <= kFormatBinary) && (c->k = (long *)calloc( c->n + 1, sizeof( long ) ));
+	for( i = c->level; valid && (i <= c->n); i++ )
+		valid = (fscanf( file, " k %ld lower %*d upper %*d", c->k + i ) == 1);
+	fclose( file );
+	if( !valid )
+	{
+		printf( "Error! The file '%s' isn't a checkpoint.\n", c->name );
+		return( kFalse );
+	}
+	c->terminal = terminal;
+	c->overflow = overflow;
+	c->format = format;
+	
+	return( kTrue );
+}
+
+/* doEstimateProgress -	call to estimate how much of the search comes before the given position (as a fraction) */
+/*	We count the values each k-value has already stepped past, as if the subtrees below them were all the same size
+	(which they're not: the small values of k_n have by far the biggest, so this is an underestimate early on).	*/
+static double doEstimateProgress( long n, long level, long *k, long *lowers, long *uppers )
+{
+	double		fraction = 0, scale = 1;
+	long		i;
+	
+	for( i = n; i >= level; i-- )
+	{
+		if( uppers[i] < lowers[i] )
+			break;
+		scale /= uppers[i] - lowers[i] + 1;
+		fraction += (k[i] - lowers[i]) * scale;
+	}
+	
+	return( fraction > 1 ? 1 : fraction );
+}
+
+/* doRunParallel -	call to run the search on the given number of threads, splitting it after depth levels */
+/*	The serial search is run down to the split level, recording each subtree it reaches as a task. Each thread is
+	given a contiguous share of the tasks, which it works through from the front; once it runs out it steals from
+	the back of whichever share has the most left. A task's output is buffered, and written out once every earlier
+	task has been, so that the results come out in exactly the order of the serial search. If anything goes wrong
+	before the first task is searched we return false, and the caller runs the search serially instead.	*/
+static char doRunParallel( WeightPtr w, long numThreads, long depth )
+{
+	PoolRec		pool;
+	WorkerRec	workers[kMaxThreads];
+	pthread_t	threads[kMaxThreads];
+	char		started[kMaxThreads];
+	long		i;
+	
+	/* split the search, keeping above the level where the leaves are checked */
+	memset( (void *)&pool, 0, sizeof( PoolRec ) );
+	w->splitAt = w->n - depth;
+	if( w->terminal && (w->splitAt < 3) )	w->splitAt = 3;
+	if( !w->terminal && (w->splitAt < 1) )	w->splitAt = 1;
+	if( w->splitAt > w->n )
+	{
+		w->splitAt = kNoSplit;
+		return( kFalse );
+	}
+	w->pool = &pool;
+	doCalculatek( w, w->n );
+	pool.level = w->splitAt;
+	w->splitAt = kNoSplit;
+	w->pool = kFalse;
+	pool.sink = w->sink;
+	pool.weight = w;
+	pool.numFound = w->numFound;
+	pool.overflow = w->overflow;
+	pool.numThreads = numThreads;
+	
+	/* set up each thread's share of the tasks, and its own weight */
+	if( pool.failed || !(pool.deques = (DequePtr)calloc( numThreads, sizeof( DequeRec ) ))
+		|| !(pool.workers = (WeightPtr *)calloc( numThreads, sizeof( WeightPtr ) )) )
+	{
+		printf( "Not enough memory to split the calculation; continuing on one thread.\n" );
+		doDisposePool( &pool );
+		return( kFalse );
+	}
+	for( i = 0; i < numThreads; i++ )
+	{
+		pool.deques[i].next = i * pool.numTasks / numThreads;
+		pool.deques[i].end = (i + 1) * pool.numTasks / numThreads;
+		pthread_mutex_init( &pool.deques[i].lock, NULL );
+		if( !(pool.workers[i] = (WeightPtr)calloc( 1, sizeof( WeightRec ) )) )
+		{
+			printf( "Not enough memory to split the calculation; continuing on one thread.\n" );
+			doDisposePool( &pool );
+			return( kFalse );
+		}
+		pool.workers[i]->terminal = w->terminal;
+		pool.workers[i]->n = w->n;
+		pool.workers[i]->splitAt = kNoSplit;
+		pool.workers[i]->pool = &pool;
+		if( !(pool.workers[i]->k = (long *)calloc( w->n + 1, sizeof( long ) )) || !doNewState( pool.workers[i] )
+			|| (w->memo && !doNewMemo( pool.workers[i], w->memoSize / numThreads )) )
+		{
+			printf( "Not enough memory to split the calculation; continuing on one thread.\n" );
+			doDisposePool( &pool );
+			return( kFalse );
+		}
+		memcpy( (void *)pool.workers[i]->sliceFrom, (void *)w->sliceFrom, sizeof( long ) * (w->n + 1) );
+		memcpy( (void *)pool.workers[i]->sliceTo, (void *)w->sliceTo, sizeof( long ) * (w->n + 1) );
+		pool.workers[i]->sliceLevel = w->sliceLevel;
+#ifdef kInstrument
+		if( w->stats && !doNewStats( pool.workers[i] ) )
+		{
+			printf( "Not enough memory to split the calculation; continuing on one thread.\n" );
+			doDisposePool( &pool );
+			return( kFalse );
+		}
+#endif
+	}
+	pthread_mutex_init( &pool.emitLock, NULL );
+	
+	/* start the threads (this one being the first); any share without a thread is stolen by the others */
+	for( i = 0; i < numThreads; i++ )
+	{
+		workers[i].pool = &pool;
+		workers[i].index = i;
+		started[i] = i && !pthread_create( threads + i, NULL, doWorkerThread, (void *)(workers + i) );
+	}
+	doWorkerThread( (void *)workers );
+	for( i = 1; i < numThreads; i++ )
+		if( started[i] )
+			pthread_join( threads[i], NULL );
+	
+	/* finish up */
+	for( i = 0; i < numThreads; i++ )
+	{
+		w->overflow |= pool.workers[i]->overflow;
+		w->numFound += pool.workers[i]->numFound;
+		w->memoHits += pool.workers[i]->memoHits;
+		w->nodes += pool.workers[i]->nodes;
+		w->memoMisses += pool.workers[i]->memoMisses;
+#ifdef kInstrument
+		if( w->stats )
+			doMergeStats( w->stats, pool.workers[i]->stats, w->n );
+#endif
+	}
+	pthread_mutex_destroy( &pool.emitLock );
+	doDisposePool( &pool );
+	
+	return( kTrue );
+}
+
+/* doAddTask -	call to record the subtree below the split level of the search as a task */
+static void doAddTask( WeightPtr w )
+{
+	PoolPtr		pool = w->pool;
+	TaskPtr		task;
+	
+	if( pool->failed )
+		return;
+	
+	/* make room for the task */
+	if( pool->numTasks == pool->maxTasks )
+	{
+		long		maxTasks = pool->maxTasks ? 2 * pool->maxTasks : 1024;
+		TaskPtr		tasks;
+		
+		if( !(tasks = (TaskPtr)realloc( (void *)pool->tasks, sizeof( TaskRec ) * maxTasks )) )
+		{
+			pool->failed = kTrue;
+			return;
+		}
+		pool->tasks = tasks;
+		pool->maxTasks = maxTasks;
+	}
+	
+	/* and record the k-values above it, and their ranges */
+	task = pool->tasks + pool->numTasks;
+	memset( (void *)task, 0, sizeof( TaskRec ) );
+	if( !(task->k = (long *)malloc( 3 * sizeof( long ) * (w->n + 1) )) )
+	{
+		pool->failed = kTrue;
+		return;
+	}
+	task->lowers = task->k + w->n + 1;
+	task->uppers = task->lowers + w->n + 1;
+	memcpy( (void *)task->k, (void *)w->k, sizeof( long ) * (w->n + 1) );
+	memcpy( (void *)task->lowers, (void *)w->lowers, sizeof( long ) * (w->n + 1) );
+	memcpy( (void *)task->uppers, (void *)w->uppers, sizeof( long ) * (w->n + 1) );
+	pool->numTasks++;
+	
+	/* if we're resuming a search that picks up again inside this subtree, it's up to the task to skip what was searched */
+	task->resume = (w->resumeLevel != 0);
+	w->resumeLevel = 0;
+}
+
+/* doWorkerThread -	call to search tasks until there are none left, writing out whatever output is next in order */
+static void *doWorkerThread( void *worker )
+{
+	PoolPtr		pool = ((WorkerPtr)worker)->pool;
+	long		index = ((WorkerPtr)worker)->index, t;
+	WeightPtr	w = pool->workers[index];
+	
+	while( (t = doTakeTask( pool, index )) >= 0 )
+	{
+		TaskPtr		task = pool->tasks + t;
+		long		numFound = w->numFound;
+		char		overflow = w->overflow;
+		
+		/* search the subtree, collecting the output */
+		memcpy( (void *)w->k, (void *)task->k, sizeof( long ) * (w->n + 1) );
+		doResetState( w, pool->level );
+		w->results = pool->sink ? &task->results : kFalse;
+		w->overflow = kFalse;
+		if( task->resume )
+		{
+			w->resumeLevel = pool->weight->checkpoint->level;
+			w->resumeAt = pool->weight->checkpoint->k;
+		}
+		MTimed( w, w->stats->levels[pool->level].time, doCalculatek( w, pool->level ) );
+		w->results = kFalse;
+		task->numFound = w->numFound - numFound;
+		task->overflow = w->overflow;
+		w->overflow |= overflow;
+		
+		doEmitTasks( pool, t );
+	}
+	
+	return( NULL );
+}
+
+/* doTakeTask -	call to take the next task from the thread's share, or else to steal one (returns -1 if there are none left) */
+static long doTakeTask( PoolPtr pool, long index )
+{
+	DequePtr	d = pool->deques + index;
+	long		t = -1, i, victim, most;
+	
+	/* our own share, from the front */
+	pthread_mutex_lock( &d->lock );
+	if( d->next < d->end )		t = d->next++;
+	pthread_mutex_unlock( &d->lock );
+	
+	/* otherwise, steal from the back of the biggest share (which may have changed by the time we lock it) */
+	while( t < 0 )
+	{
+		for( victim = -1, most = 0, i = 0; i < pool->numThreads; i++ )
+			if( pool->deques[i].end - pool->deques[i].next > most )
+			{
+				most = pool->deques[i].end - pool->deques[i].next;
+				victim = i;
+			}
+		if( victim < 0 )
+			break;
+		d = pool->deques + victim;
+		pthread_mutex_lock( &d->lock );
+		if( d->next < d->end )		t = --d->end;
+		pthread_mutex_unlock( &d->lock );
+	}
+	
+	return( t );
+}
+
+/* doEmitTasks -	call to mark the task as done, and write out the output of every finished task that's next in order */
+static void doEmitTasks( PoolPtr pool, long t )
+{
+	pthread_mutex_lock( &pool->emitLock );
+	pool->tasks[t].done = kTrue;
+	while( (pool->nextToEmit < pool->numTasks) && pool->tasks[pool->nextToEmit].done )
+	{
+		TaskPtr		task = pool->tasks + pool->nextToEmit++;
+		long		i;
+		
+		/* (holding the lock, we're the only thread handing weights to the writer) */
+		for( i = 0; i < task->results.length; i += pool->sink->n + 2 )
+		{
+			memcpy( (void *)doReserveResult( pool->sink ), (void *)(task->results.values + i), sizeof( long ) * (pool->sink->n + 2) );
+			doCommitResult( pool->sink );
+		}
+		if( task->results.failed )
+			printf( "Error! Not enough memory to buffer the output; some weights have been lost.\n" );
+		pool->numFound += task->numFound;
+		pool->overflow |= task->overflow;
+		free( (void *)task->results.values );
+		free( (void *)task->k );
+		task->results.values = kFalse;
+		task->k = kFalse;
+	}
+	
+	/* every so often, save the position of the search (which picks up again at the next task to be written) */
+	if( pool->weight->checkpoint && (pool->nextToEmit < pool->numTasks) && !pool->tasks[pool->nextToEmit].resume
+		&& (time( NULL ) >= pool->weight->checkpoint->due) )
+	{
+		TaskPtr		task = pool->tasks + pool->nextToEmit;
+		
+		doSaveCheckpoint( pool->weight, pool->level + 1, task->k, task->lowers, task->uppers, pool->numFound, pool->overflow );
+	}
+	pthread_mutex_unlock( &pool->emitLock );
+}
+
+/* doDisposePool -	call to free the memory of a pool of tasks */
+static void doDisposePool( PoolPtr pool )
+{
+	long		i;
+	
+	for( i = 0; i < pool->numTasks; i++ )
+	{
+		free( (void *)pool->tasks[i].results.values );
+		free( (void *)pool->tasks[i].k );
+	}
+	free( (void *)pool->tasks );
+	if( pool->deques )
+		for( i = 0; i < pool->numThreads; i++ )
+			pthread_mutex_destroy( &pool->deques[i].lock );
+	free( (void *)pool->deques );
+	if( pool->workers )
+		for( i = 0; i < pool->numThreads; i++ )
+			doDisposeWeight( pool->workers[i] );
+	free( (void *)pool->workers );
+}
+
+/* doReadBatch -	call to read a list of jobs such as "5n,6y,7y" (the dimension, and whether to limit to terminal singularities) */
+static char doReadBatch( BatchPtr batch, char *list )
+{
+	char		*s;
+	long		numJobs = 1;
+	
+	/* make room for the jobs */
+	for( s = list; *s; s++ )
+		if( *s == ',' )		numJobs++;
+	if( !(batch->jobs = (JobPtr)calloc( numJobs, sizeof( JobRec ) )) )
+	{
+		printf( "Not enough memory for the list of jobs!\n" );
+		return( kFalse );
+	}
+	
+	/* and read them */
+	for( s = list; batch->numJobs < numJobs; s++ )
+	{
+		JobPtr		job = batch->jobs + batch->numJobs++;
+		
+		job->n = strtol( s, &s, 10 );
+		if( ((*s != 'y') && (*s != 'n')) || ((s[1] != ',') && s[1]) )
+		{
+			printf( "Error! Each job must be a dimension followed by 'y' or 'n' (terminal singularities only?), as in \"5n,6y\".\n" );
+			return( kFalse );
+		}
+		job->terminal = (*s++ == 'y');
+	}
+	
+	return( kTrue );
+}
+
+/* doRunBatch -	call to run the jobs in a batch, up to the given number at a time, and summarise them */
+static void doRunBatch( BatchPtr batch, long numThreads )
+{
+	pthread_t	threads[kMaxThreads];
+	char		started[kMaxThreads];
+	long		i;
+	
+	/* start the threads (this one being the first); each takes the next job until there are none left */
+	pthread_mutex_init( &batch->lock, NULL );
+	for( i = 1; i < numThreads; i++ )
+		started[i] = !pthread_create( threads + i, NULL, doBatchThread, (void *)batch );
+	doBatchThread( (void *)batch );
+	for( i = 1; i < numThreads; i++ )
+		if( started[i] )
+			pthread_join( threads[i], NULL );
+	pthread_mutex_destroy( &batch->lock );
+	
+	/* summarise the jobs, in the order given */
+	printf( "\n" );
+	for( i = 0; i < batch->numJobs; i++ )
+	{
+		JobPtr		job = batch->jobs + i;
+		
+		printf( "Dimension %ld, %s singularities: ", job->n, job->terminal ? "terminal" : "canonical" );
+		if( job->failed )	printf( "not run.\n" );
+		else
+		{
+			if( batch->quiet )	printf( "%ld weights.\n", job->numFound );
+			else				printf( "%ld weights (dim_%ld_%s.txt).\n", job->numFound, job->n, job->terminal ? "term" : "canon" );
+			if( job->overflow )
+				printf( "Warning! Some of the numbers were too large to hold, so part of the search was skipped;\nthe list may not be complete.\n" );
+		}
+	}
+}
+
+/* doBatchThread -	call to run the next job in the batch, until there are none left */
+/*	A thread keeps one cache of primes and divisors for all the jobs it runs, so later jobs start with it warm.	*/
+static void *doBatchThread( void *b )
+{
+	BatchPtr	batch = (BatchPtr)b;
+	CachePtr	cache;
+	long		j;
+	
+	if( !(cache = doNewCache()) )
+	{
+		printf( "Not enough memory for a cache of primes and divisors!\n" );
+		return( NULL );
+	}
+	for( ;; )
+	{
+		pthread_mutex_lock( &batch->lock );
+		j = batch->nextJob < batch->numJobs ? batch->nextJob++ : -1;
+		pthread_mutex_unlock( &batch->lock );
+		if( j < 0 )
+			break;
+		doRunJob( batch, batch->jobs + j, cache );
+	}
+	doDisposeCache( cache );
+	
+	return( NULL );
+}
+
+/* doRunJob -	call to run a single job of a batch, listing the weights to its own file (unless we're only counting them) */
+static void doRunJob( BatchPtr batch, JobPtr job, CachePtr cache )
+{
+	WeightPtr	w;
+	SinkPtr		sink = kFalse;
+	FILE		*listing = kFalse, *file = kFalse;
+	char		name[25];
+	
+	/* create the files, and start the writer */
+	sprintf( name, "dim_%ld_%s.txt", job->n, job->terminal ? "term" : "canon" );
+	if( !batch->quiet && !(listing = fopen( name, "w" )) )
+	{
+		printf( "Error! Unable to create file '%s'.\n", name );
+		job->failed = kTrue;
+		return;
+	}
+	if( batch->saveFile )
+		file = doCreateOutputFile( job->n, job->terminal, batch->format );
+	if( (listing || file) && !(sink = doNewSink( job->n, listing, file, batch->format )) )
+	{
+		if( file )		doCloseOutputFile( file, batch->format );
+		if( listing )	fclose( listing );
+		job->failed = kTrue;
+		return;
+	}
+	
+	/* run the search */
+	if( !(w = doNewWeight( job->n, job->terminal, cache, sink )) )
+	{
+		doDisposeSink( sink );
+		if( listing )	fclose( listing );
+		job->failed = kTrue;
+		return;
+	}
+	if( batch->memoBytes && !doNewMemo( w, batch->memoBytes / (long)sizeof( MemoRec ) ) )
+		printf( "Not enough memory for the memo table; continuing without it.\n" );
+	doCalculatek( w, w->n );
+	doDisposeSink( sink );
+	if( w->overflow && listing )
+		fprintf( listing, "\nWarning! Some of the numbers were too large to hold, so part of the search was skipped;\nthe list above may not be complete.\n" );
+	job->numFound = w->numFound;
+	job->overflow = w->overflow;
+	
+	/* and finish up */
+	doDisposeWeight( w );
+	if( listing )	fclose( listing );
+}
+
+/* doReadSlice -	call to read the slice of the search a weight is confined to */
+/*	A slice is given by its ends, "k_n,k_{n-1},...:k_n,k_{n-1},...", either of which may be left out or cut short; a
+	single list of k-values is the slice both starting and ending there, i.e. everything below it.	*/
+static char doReadSlice( WeightPtr w, char *spec )
+{
+	char		*s = spec, end;
+	long		i, *edge;
+	
+	for( end = 0; end < 2; end++ )
+	{
+		edge = end ? w->sliceTo : w->sliceFrom;
+		for( i = w->n; *s && (*s != ':'); i-- )
+		{
+			if( (i < 0) || (*s < '0') || (*s > '9') )
+				break;
+			edge[i] = strtol( s, &s, 10 );
+			if( i < w->sliceLevel )		w->sliceLevel = i;
+			if( *s == ',' )		s++;
+		}
+		if( !end && !*s )
+		{	/* (a prefix) */
+			memcpy( (void *)w->sliceTo, (void *)w->sliceFrom, sizeof( long ) * (w->n + 1) );
+			break;
+		}
+		if( end ? *s : (*s++ != ':') )
+		{
+			printf( "Error! A slice must be given as k_n,k_{n-1},...:k_n,k_{n-1},... (either end may be left out or cut\nshort), as in \"5:7,20\".\n" );
+			return( kFalse );
+		}
+	}
+	if( w->sliceLevel <= (w->terminal ? 2 : 0) )
+	{
+		printf( "Error! The slice goes below the levels the search steps through (use -test to check a whole weight).\n" );
+		return( kFalse );
+	}
+	
+	return( kTrue );
+}
+
+/* doOnSliceEdge -	call to see whether the k-values above k_i are those at the given end of the slice */
+MInline char doOnSliceEdge( WeightPtr w, long i, long *edge )
+{
+	long		j;
+	
+	for( j = i + 1; j <= w->n; j++ )
+		if( w->k[j] != edge[j] )
+			return( kFalse );
+	
+	return( kTrue );
+}
+
+/* doInSlice -	call to see whether the k-values lie in the slice */
+static char doInSlice( WeightPtr w )
+{
+	long		i;
+	
+	for( i = w->n; (i >= w->sliceLevel) && (w->k[i] == w->sliceFrom[i]); i-- )
+		;
+	if( (i >= w->sliceLevel) && (w->k[i] < w->sliceFrom[i]) )
+		return( kFalse );
+	for( i = w->n; (i >= w->sliceLevel) && (w->k[i] == w->sliceTo[i]); i-- )
+		;
+	
+	return( (i < w->sliceLevel) || (w->k[i] < w->sliceTo[i]) );
+}
+
+/* doTally -	call to count a subtree of the search below the current (k_n, k_{n-1}) */
+/*	The subtrees are reached in order, so we need only look at the last (k_n, k_{n-1}) we counted.	*/
+static void doTally( WeightPtr w )
+{
+	ResultsPtr	t = w->tallies;
+	long		*last = t->values + t->length - 3;
+	
+	if( t->failed )
+		return;
+	if( t->length && (last[0] == w->k[w->n]) && (last[1] == w->k[w->n - 1]) )
+	{
+		last[2]++;
+		return;
+	}
+	if( t->length + 3 > t->size )
+	{
+		long		size = t->size ? 2 * t->size : 3 * 1024;
+		long		*values;
+		
+		if( !(values = (long *)realloc( (void *)t->values, sizeof( long ) * size )) )
+		{
+			t->failed = kTrue;
+			return;
+		}
+		t->values = values;
+		t->size = size;
+	}
+	t->values[t->length++] = w->k[w->n];
+	t->values[t->length++] = w->k[w->n - 1];
+	t->values[t->length++] = 1;
+}
+
+/* doEstimateSlices -	call to propose slices of the search that ought to take about as long as each other */
+/*	The search is run down to the given depth, counting the subtrees below each (k_n, k_{n-1}), and the pairs are
+	divided up in order, each slice taking its share of what the slices before it left. The deeper we look the better the estimate, but the
+	longer it takes. The slices between them cover the whole search, whatever the estimate.	*/
+static void doEstimateSlices( long n, char terminal, long numSlices, long depth )
+{
+	WeightPtr	w;
+	ResultsRec	tallies;
+	long		i, total = 0, done = 0, count = 0, slice = 0, next[2] = { 0, 0 };
+	
+	/* run the search (keeping above the level where the leaves are checked, and below the slicing) */
+	if( !(w = doNewWeight( n, terminal, kFalse, kFalse )) )
+		return;
+	w->splitAt = n - depth;
+	if( w->terminal && (w->splitAt < 3) )	w->splitAt = 3;
+	if( !w->terminal && (w->splitAt < 1) )	w->splitAt = 1;
+	if( w->splitAt > n - 2 )
+	{
+		printf( "The search in dimension %ld is too small to be sliced!\n", n );
+		doDisposeWeight( w );
+		return;
+	}
+	memset( (void *)&tallies, 0, sizeof( ResultsRec ) );
+	w->tallies = &tallies;
+	doCalculatek( w, n );
+	if( tallies.failed )
+		printf( "Not enough memory to estimate the slices!\n" );
+	else
+	{
+		/* and divide the (k_n, k_{n-1}) up */
+		for( i = 0; i < tallies.length; i += 3 )	total += tallies.values[i + 2];
+		printf( "%ld subtrees %ld levels down; the slices are:\n", total, n - w->splitAt );
+		for( i = 0; i < tallies.length; i += 3 )
+		{
+			count += tallies.values[i + 2];
+			if( (slice < numSlices - 1) && (i + 3 < tallies.length) && (count * (numSlices - slice) >= total - done) )
+			{
+				printf( "\t-slice " );
+				if( slice )		printf( "%ld,%ld", next[0], next[1] );
+				printf( ":%ld,%ld\t(%.1f%%)\n", tallies.values[i], tallies.values[i + 1], 100.0 * count / total );
+				next[0] = tallies.values[i];
+				next[1] = tallies.values[i + 1] + 1;
+				done += count;
+				count = 0;
+				slice++;
+			}
+		}
+		printf( "\t-slice " );
+		if( slice )		printf( "%ld,%ld", next[0], next[1] );
+		printf( ":\t(%.1f%%)\n", total ? 100.0 * count / total : 100.0 );
+	}
+	free( (void *)tallies.values );
+	doDisposeWeight( w );
+}
+
+/* doMergeSlices -	call to merge the weights saved from the slices of a search into the output, in order and without repeats */
+/*	(Repeats only turn up if the slices overlap, but then they do no harm.) The weights are held with their length in front, so that they can be compared without knowing the dimension.	*/
+static char doMergeSlices( char **names, long numNames, char format, char quiet )
+{
+	FILE		*file;
+	SinkPtr		sink = kFalse;
+	long		header[2], n = -1, terminal = 0, length = 0, size = 0, *values = kFalse, *result, i, j, numFound = 0;
+	
+	/* read the weights from each slice */
+	for( i = 0; i < numNames; i++ )
+	{
+		if( !(file = fopen( names[i], "rb" )) )
+		{
+			printf( "Error! Unable to open file '%s'.\n", names[i] );
+			free( (void *)values );
+			return( kFalse );
+		}
+		if( (fread( (void *)header, sizeof( long ), 2, file ) != 2) || (header[0] < 2) || ((n >= 0)
+			&& ((header[0] != n) || (header[1] != terminal))) )
+		{
+			printf( "Error! The file '%s' isn't a slice of the same search as the others.\n", names[i] );
+			fclose( file );
+			free( (void *)values );
+			return( kFalse );
+		}
+		n = header[0];
+		terminal = header[1];
+		for( ;; )
+		{
+			if( length + n + 3 > size )
+			{
+				long		*more;
+				
+				size = size ? 2 * size : 1024 * (n + 3);
+				if( !(more = (long *)realloc( (void *)values, sizeof( long ) * size )) )
+				{
+					printf( "Not enough memory to merge the slices!\n" );
+					fclose( file );
+					free( (void *)values );
+					return( kFalse );
+				}
+				values = more;
+			}
+			if( fread( (void *)(values + length + 1), sizeof( long ), n + 2, file ) != (size_t)(n + 2) )
+				break;
+			values[length] = n + 2;
+			length += n + 3;
+		}
+		fclose( file );
+	}
+	
+	/* sort them, and write them out (skipping any repeats) */
+	qsort( (void *)values, length / (n + 3), sizeof( long ) * (n + 3), doCompareWeights );
+	file = doCreateOutputFile( n, terminal, format );
+	if( (file || !quiet) && !(sink = doNewSink( n, quiet ? kFalse : stdout, file, format )) )
+	{
+		if( file )	doCloseOutputFile( file, format );
+		free( (void *)values );
+		return( kFalse );
+	}
+	if( terminal )
+	{	/* (P^n is in none of the slices; as ever, it's listed but not written to the file) */
+		numFound++;
+		if( !quiet )
+		{
+			for( j = 0; j <= n; j++ )	printf( "1, " );
+			printf( "h=%ld\n", n + 1 );
+		}
+	}
+	for( i = 0; i < length; i += n + 3 )
+	{
+		if( i && !doCompareWeights( (void *)(values + i - n - 3), (void *)(values + i) ) )
+			continue;
+		numFound++;
+		if( file || !quiet )
+		{
+			result = doReserveResult( sink );
+			for( j = 0; j < n + 2; j++ )	result[j] = values[i + j + 1];
+			doCommitResult( sink );
+		}
+	}
+	if( file || !quiet )
+		doDisposeSink( sink );
+	free( (void *)values );
+	printf( "\n%ld weights, from %ld slices.\n", numFound, numNames );
+	
+	return( kTrue );
+}
+
+/* doRunTest -	call to check a single weight, "l_0,...,l_n", for both canonical and terminal singularities */
+static char doRunTest( char *spec )
+{
+	WeightPtr	w;
+	long		*lambdas, i, n = 0, hcf = 0;
+	char		*s, terminal, valid[2] = { kFalse, kFalse };
+	
+	/* read the weight (a \lambda_i too big for a long is an error, not LONG_MAX) */
+	for( s = spec; *s; s++ )
+		if( *s == ',' )		n++;
+	if( !(lambdas = (long *)malloc( sizeof( long ) * (n + 2) )) )
+	{
+		printf( "Not enough memory to read the weight!\n" );
+		return( kFalse );
+	}
+	errno = 0;
+	for( s = spec, i = 0; (i <= n) && (*s >= '0') && (*s <= '9'); i++ )
+	{
+		lambdas[i] = strtol( s, &s, 10 );
+		if( *s == ',' )		s++;
+	}
+	if( *s || (i <= n) || (n < 2) )
+	{
+		printf( "Error! A weight must be given as l_0,...,l_n, with n at least 2, as in \"1,1,1,2\".\n" );
+		free( (void *)lambdas );
+		return( kFalse );
+	}
+	for( i = 0; (i <= n) && (lambdas[i] > 0); i++ )
+		hcf = doFindHCF( hcf, lambdas[i] );
+	if( (errno == ERANGE) || (i <= n) )
+	{
+		printf( "Error! Each l_i must be from 1 to %ld.\n", LONG_MAX );
+		free( (void *)lambdas );
+		return( kFalse );
+	}
+	
+	/* P(l_0,...,l_n) is P(l_0/d,...,l_n/d), so take out any common factor d (the checks expect a well-formed weight) */
+	if( hcf > 1 )
+	{
+		printf( "(The l_i have the common factor %ld, so this is the weight ", hcf );
+		for( i = 0; i <= n; i++ )
+			printf( "%ld%s", lambdas[i] /= hcf, i < n ? "," : ".)\n" );
+	}
+	
+	/* and check it both ways (only P^2 is terminal in dimension 2, and the search doesn't look there) */
+	for( terminal = kFalse; terminal <= kTrue; terminal++ )
+	{
+		if( terminal && (n < 3) )
+		{
+			for( i = 0; (i <= n) && (lambdas[i] == 1); i++ )
+				;
+			valid[1] = (i > n);
+			break;
+		}
+		if( !(w = doNewWeight( n, terminal, kFalse, kFalse )) )
+		{
+			free( (void *)lambdas );
+			return( kFalse );
+		}
+		valid[(int)terminal] = doTestWeight( w, lambdas );
+		doDisposeWeight( w );
+	}
+	for( i = 0; i <= n; i++ )	printf( "%ld, ", lambdas[i] );
+	if( lambdas[n + 1] )	printf( "h=%ld\n", lambdas[n + 1] );
+	else					printf( "h doesn't fit in a long\n" );
+	printf( "Canonical: %s\nTerminal: %s\n", valid[0] ? "yes" : "no", valid[1] ? "yes" : "no" );
+	free( (void *)lambdas );
+	
+	return( kTrue );
+}
+
+/* doTestWeight -	call to check whether \lambda_0, ..., \lambda_n are the weights of a Gorenstein Fano weighted projective
+					space with the given weight's singularities */
+/*	This is the check the search makes at its leaves, without the search. The \lambda_i are sorted into the order
+	the search lists them in, and followed by h (so there must be room for n + 2).	*/
+static char doTestWeight( WeightPtr w, long *lambdas )
+{
+	fnum		h = { 0, 1 };
+	long		i;
+	
+	/* (a weight whose h doesn't fit in a long is beyond anything the search could list) */
+	qsort( (void *)lambdas, w->n + 1, sizeof( long ), doCompareLongs );
+	lambdas[w->n + 1] = 0;
+	for( i = 0; i <= w->n; i++ )
+		if( (lambdas[i] < 1) || !doAddFraction( &h, &h, lambdas[i], 1 ) )
+			return( kFalse );
+	lambdas[w->n + 1] = h.a;
+	
+	/* the \lambda_i must divide h (we have P^n as soon as they're all 1, which the check doesn't expect) */
+	for( i = 0; i <= w->n; i++ )
+	{
+		if( h.a % lambdas[i] )
+			return( kFalse );
+		w->k[i] = h.a / lambdas[i];
+	}
+	if( lambdas[w->n] == 1 )
+		return( kTrue );
+	
+	return( doCheckSumValid( w, h.a ) );
+}
+
+/* doCompareWeights -	compare two weights, each held with its length in front (for qsort) */
+static int doCompareWeights( const void *a, const void *b )
+{
+	long		*x = (long *)a, *y = (long *)b, i;
+	
+	for( i = 1; i <= x[0]; i++ )
+		if( x[i] != y[i] )
+			return( (x[i] > y[i]) - (x[i] < y[i]) );
+	
+	return( 0 );
+}
+
+/* doCreateOutputFile -	call to create an output file in the given format, and write the headers */
+/*	A CSV file has a line of column names, and then a line for each weight. A binary file is a sequence of longs (in
+	this machine's format): n, and then \lambda_0, ..., \lambda_n, h for each weight.	*/
+static FILE *doCreateOutputFile( long n, char terminal, char format )
+{
+	char		name[25];
+	FILE		*file;
+	
+	/* create the file name */
+	doOutputFileName( name, n, terminal, format );
+	
+	/* create the file */
+	if( !(file = fopen( name, format == kFormatBinary ? "wb" : "w" )) )
+		printf( "Error! Unable to create file '%s'.\n", name );
+	else if( format == kFormatCSV )
+	{
+		long		i;
+		
+		for( i = 0; i <= n; i++ )	fprintf( file, "lambda_%ld,", i );
+		fprintf( file, "h\n" );
+	}
+	else if( format == kFormatBinary )
+		fwrite( (void *)&n, sizeof( long ), 1, file );
+	else
+	{	/* write the file headers */
+		long		i;
+		
+		if( terminal )	fprintf( file, "$n=%d$; terminal singularities.\n\n\\begin{tabular}{|", n );
+		else			fprintf( file, "$n=%d$; canonical singularities.\n\n\\begin{tabular}{|", n );
+		for( i = 0; i <= n; i++ )	fprintf( file, "c" );
+		fprintf( file, "|c|}\n\\hline\n" );
+		for( i = 0; i <= n; i++ )	fprintf( file, "$\\lambda_%d$&", i );
+		fprintf( file, "$h$\\\\\n\\hline\n" );
+	}
+	
+	return( file );
+}
+
+/* doReopenOutputFile -	call to open an existing output file, to carry on writing it after the first offset bytes */
+static FILE *doReopenOutputFile( long n, char terminal, char format, long offset )
+{
+	char		name[25];
+	FILE		*file;
+	
+	doOutputFileName( name, n, terminal, format );
+	if( !(file = fopen( name, "r+b" )) || ftruncate( fileno( file ), offset ) || fseek( file, offset, SEEK_SET ) )
+	{
+		printf( "Error! Unable to reopen file '%s'.\n", name );
+		if( file )	fclose( file );
+		return( kFalse );
+	}
+	
+	return( file );
+}
+
+/* doOutputFileName -	call to find the name of the output file */
+static void doOutputFileName( char *name, long n, char terminal, char format )
+{
+	static const char	*extensions[] = { "tex", "csv", "dat" };
+	
+	if( terminal )	sprintf( name, "dim_%ld_term.%s", n, extensions[(int)format] );
+	else			sprintf( name, "dim_%ld_canon.%s", n, extensions[(int)format] );
+}
+
+/* doCloseOutputFile -	call to close the output file */
+static void doCloseOutputFile( FILE *file, char format )
+{
+	/* write the footers */
+	if( format == kFormatTeX )
+		fprintf( file, "\\hline\n\\end{tabular}\n" );
+	
+	/* finally, close the file */
+	fclose( file );
+}
+
+/* doNewWeight -	call to allocate the memory for a new weight of dimension n */
+/*	The weight may share a cache of primes and divisors with others (if not, pass 0 and it gets its own). It hands
+	the weights it finds to the given writer (or, if there isn't one, just counts them).	*/
+static WeightPtr doNewWeight( long n, char terminal, CachePtr cache, SinkPtr sink )
+{
+	WeightPtr	w = kFalse;
+	long		i;
+	
+	/* check the dimension is valid */
+	if( n < 2 )
+	{
+		printf( "The dimension must be greater than 1! (You have entered %d.)\n", n );
+		return( kFalse );
+	}
+	else if( (n < 3) && terminal )
+	{
+		printf( "In the terminal case, the dimension must be greater than 2! (You have entered 2.)\n" );
+		return( kFalse );
+	}
+	
+	/* allocate the memory for the weight */
+	if( !(w = (WeightPtr)malloc( sizeof( WeightRec ) )) )
+	{
+		printf( "Not enough memory to create the weight structure!\n" );
+		return( kFalse );
+	}
+	
+	/* allocate the memory for the k-value array, and the state we carry down the recursion */
+	w->n = n;
+	w->lowers = w->uppers = kFalse;
+	w->sliceFrom = w->sliceTo = kFalse;
+	w->sums = kFalse;
+	w->lcms = kFalse;
+	w->multiples = kFalse;
+	w->nextMultiple = kFalse;
+	w->tests = kFalse;
+	w->cache = cache;
+	w->ownsCache = kFalse;
+	w->memo = kFalse;
+	w->memoSize = w->memoHits = w->memoMisses = 0;
+	w->nodes = 0;
+	if( !(w->k = (long *)malloc( sizeof( long ) * (n + 1) )) || !doNewState( w ) )
+	{
+		doDisposeWeight( w );
+		printf( "Not enough memory to create a k array!\n" );
+		return( kFalse );
+	}
+	
+	/* set the singularity type and the writer */
+	w->terminal = terminal;
+	w->sink = sink;
+	w->numFound = 0;
+	w->overflow = kFalse;
+	w->splitAt = kNoSplit;
+	w->pool = kFalse;
+	w->results = kFalse;
+	w->checkpoint = kFalse;
+	w->resumeLevel = 0;
+	w->resumeAt = kFalse;
+	for( i = 0; i <= n; i++ )
+	{
+		w->sliceFrom[i] = 0;
+		w->sliceTo[i] = LONG_MAX;
+	}
+	w->sliceLevel = n + 1;
+	w->tallies = kFalse;
+#ifdef kInstrument
+	w->stats = kFalse;
+#endif
+	
+	/* if we're in the terminal case, add P^n by hand, since we use sharp bounds which assume that \lambda_n > 1. */
+	if( terminal )
+		doAddProjectiveSpace( w );
+	
+	/* finally, zero the array; we're ready to begin */
+	for( i = 0; i <= n; i++ )	w->k[i] = 0;
+	doResetState( w, n );
+	
+	return( w );
+}
+	
+/* doDisposeWeight -	call to free the memory of a weight */
+static void doDisposeWeight( WeightPtr w )
+{
+	/* check that we actually have a weight before we try to dispose of it */
+	if( w )
+	{
+		/* dispose of the k-array and the recursion state */
+		if( w->k )			free( (void *)w->k );
+		if( w->lowers )		free( (void *)w->lowers );
+		if( w->uppers )		free( (void *)w->uppers );
+		if( w->sliceFrom )	free( (void *)w->sliceFrom );
+		if( w->sliceTo )	free( (void *)w->sliceTo );
+		if( w->sums )		free( (void *)w->sums );
+		if( w->lcms )		free( (void *)w->lcms );
+		if( w->multiples )	free( (void *)w->multiples );
+		if( w->nextMultiple )	free( (void *)w->nextMultiple );
+		if( w->tests )			free( (void *)w->tests );
+		if( w->memo )			free( (void *)w->memo );
+		if( w->cache && w->ownsCache )	doDisposeCache( w->cache );
+#ifdef kInstrument
+		if( w->stats )
+		{
+			free( (void *)w->stats->levels );
+			free( (void *)w->stats );
+		}
+#endif
+		
+		/* dispose of the weight */
+		free( (void *)w );
+	}
+}
+
+/* doCalculatek -	calculates recursively the possible k-values */
+static void doCalculatek( WeightPtr w, long i )
+{
+	long		lower, upper, j;
+	fnum		sum = w->sums[i];
+	wide		bound;
+	char		leaf;
+	
+	/* in a parallel run, everything below the split level is handed out as a task (or, if we're estimating, counted) */
+	if( i == w->splitAt )
+	{
+		if( w->pool )	doAddTask( w );
+		else			doTally( w );
+		return;
+	}
+	w->nodes++;
+	MStat( w, w->stats->levels[i].nodes++ );
+	
+	/* first check that we're not already calculated enough */
+	if( w->terminal && (i <= 2) )
+	{	/* terminal bound */
+		doFinishCalculationTerminal( w );
+		return;
+	}
+	else if( !w->terminal && !i )
+	{	/* canonical bound */
+		doFinishCalculationCanonical( w );
+		return;
+	}
+	
+	/* otherwise, step through the possible values of k_i */
+	/* first establish the lower bounds */
+	lower = w->n-i+2;
+	if( w->terminal )	lower++;
+	if( (i < w->n) && (lower < w->k[i+1]) )	lower = w->k[i+1];
+	
+	/* now the upper bounds, (i + 1) / (1 - sum) (if the sum so far has reached 1 there's no room for k_i at all) */
+	if( sum.a >= sum.b )
+	{
+		MStat( w, w->stats->levels[i].fullSums++ );
+		return;
+	}
+	if( (bound = (wide)(i + 1) * sum.b / (sum.b - sum.a)) > LONG_MAX )
+	{
+		MStat( w, w->stats->levels[i].overflows++ );
+		w->overflow = kTrue;
+		return;
+	}
+	upper = (long)bound;
+			
+	/* is this range sensible? */
+	if( upper < lower )
+	{
+		MStat( w, w->stats->levels[i].emptyBound++ );
+		return;
+	}
+	MStat( w, w->stats->levels[i].widthBound += upper - lower + 1 );
+	
+	/* now check whether the upper bound can be bettered by direct calculation */
+	if( i < w-> n )
+	{
+		MTimed( w, w->stats->levels[i].tightenTime, upper = doTightenUpper( w, i, upper ) );
+	}
+	else if( w->terminal )	/* \lambda_n <= n-1 in the terminal case */
+	{
+		MStat( w, w->stats->levels[i].terminalRule++ );
+		upper = w->n - 1;
+	}
+	
+	/* keep to the slice of the search we've been given (only its ends constrain k_i, if we're still on them) */
+	if( i >= w->sliceLevel )
+	{
+		if( doOnSliceEdge( w, i, w->sliceFrom ) && (lower < w->sliceFrom[i]) )	lower = w->sliceFrom[i];
+		if( doOnSliceEdge( w, i, w->sliceTo ) && (upper > w->sliceTo[i]) )		upper = w->sliceTo[i];
+	}
+	
+	/* is the range still sensible? */
+	if( upper < lower )
+	{
+		MStat( w, w->stats->levels[i].emptyTightened++ );
+		return;
+	}
+	MStat( w, w->stats->levels[i].widthTightened += upper - lower + 1 );
+	
+	/* record the range (for the checkpoints), and if we're resuming a search, skip the values already searched */
+	w->lowers[i] = lower;
+	w->uppers[i] = upper;
+	if( w->resumeLevel )
+	{
+		if( lower < w->resumeAt[i] )	lower = w->resumeAt[i];
+		if( i == w->resumeLevel )		w->resumeLevel = 0;
+	}
+	
+	/* iterate on this range, carrying the sum, the LCM, and (unless the next level is checked as a leaf) the multiples down */
+	leaf = w->terminal ? (i - 1 <= 2) : (i - 1 == 0);
+	for( j = lower; j <= upper; j++ )
+	{
+		w->k[i] = j;
+		if( !doAddFraction( w->sums + i - 1, &sum, 1, j ) || !doFindLCM( w->lcms[i], j, w->lcms + i - 1 ) )
+		{	/* the numbers have outgrown a long, so we can't follow this branch */
+			w->overflow = kTrue;
+			continue;
+		}
+		if( !leaf )		doAddMultiples( w, j, 1 );
+		MTimed( w, w->stats->levels[i - 1].time, doCalculatek( w, i - 1 ) );
+		if( !leaf )		doAddMultiples( w, j, -1 );
+		
+		/* every so often, save the position of the search (which picks up again at the next value) */
+		if( w->checkpoint && (i == (w->terminal ? 3 : 1)) && (time( NULL ) >= w->checkpoint->due) )
+		{
+			w->k[i] = j + 1;
+			doSaveCheckpoint( w, i, w->k, w->lowers, w->uppers, w->numFound, w->overflow );
+		}
+	}
+}
+
+/* doNewState -	call to allocate the state carried down the recursion */
+static char doNewState( WeightPtr w )
+{
+	if( !(w->sums = (fnum *)malloc( sizeof( fnum ) * (w->n + 1) )) )		return( kFalse );
+	if( !(w->lcms = (long *)malloc( sizeof( long ) * (w->n + 1) )) )		return( kFalse );
+	if( !(w->nextMultiple = (long *)malloc( sizeof( long ) * (w->n + 1) )) )	return( kFalse );
+	if( !(w->tests = (DivisibilityPtr)malloc( sizeof( DivisibilityRec ) * (w->n + 1) )) )	return( kFalse );
+	if( !(w->lowers = (long *)calloc( w->n + 1, sizeof( long ) )) )		return( kFalse );
+	if( !(w->uppers = (long *)calloc( w->n + 1, sizeof( long ) )) )		return( kFalse );
+	if( !(w->sliceFrom = (long *)calloc( w->n + 1, sizeof( long ) )) )	return( kFalse );
+	if( !(w->sliceTo = (long *)calloc( w->n + 1, sizeof( long ) )) )		return( kFalse );
+	if( !w->cache )
+	{
+		if( !(w->cache = doNewCache()) )		return( kFalse );
+		w->ownsCache = kTrue;
+	}
+	w->multiples = kFalse;
+	w->numMultiples = 0;
+	
+	return( kTrue );
+}
+
+/* doResetState -	call to recalculate the state for the search below level i from the k-values k_{i+1}, ..., k_n */
+static void doResetState( WeightPtr w, long i )
+{
+	long		j, m;
+	
+	w->sums[w->n].a = 0;
+	w->sums[w->n].b = 1;
+	w->lcms[w->n] = 1;
+	for( j = w->n; j > i; j-- )
+	{
+		if( !doAddFraction( w->sums + j - 1, w->sums + j, 1, w->k[j] ) || !doFindLCM( w->lcms[j], w->k[j], w->lcms + j - 1 ) )
+			w->overflow = kTrue;
+	}
+	
+	/* the multiples table is rebuilt from scratch */
+	if( w->multiples )
+	{
+		memset( (void *)w->multiples, 0, w->numMultiples );
+		for( j = i + 1; j <= w->n; j++ )
+			for( m = w->k[j]; m < w->numMultiples; m += w->k[j] )
+				w->multiples[m]++;
+	}
+}
+
+/* doAddMultiples -	call to add (or remove, if delta is -1) the multiples of k to the multiples table */
+static void doAddMultiples( WeightPtr w, long k, long delta )
+{
+	long		m;
+	
+	for( m = k; m < w->numMultiples; m += k )
+		w->multiples[m] += delta;
+}
+
+/* doGrowMultiples -	call to make sure the multiples table covers kappa < upper, for the search below level i */
+static char doGrowMultiples( WeightPtr w, long i, long upper )
+{
+	unsigned char	*multiples;
+	long			size = w->numMultiples ? w->numMultiples : kMinMultiples, j, m;
+	
+	if( upper <= w->numMultiples )
+		return( kTrue );
+	while( size < upper )		size *= 2;
+	if( (size > kMaxMultiples) || !(multiples = (unsigned char *)realloc( (void *)w->multiples, size )) )
+		return( kFalse );
+	
+	/* fill in the new part from the k-values above level i */
+	memset( (void *)(multiples + w->numMultiples), 0, size - w->numMultiples );
+	for( j = i + 1; j <= w->n; j++ )
+		for( m = ((w->numMultiples + w->k[j] - 1) / w->k[j]) * w->k[j]; m < size; m += w->k[j] )
+			multiples[m]++;
+	w->multiples = multiples;
+	w->numMultiples = size;
+	
+	return( kTrue );
+}
+
+/* doTightenUpper -	call to check whether the upper bound can be tightened by direct calculation of the sum */
+static long doTightenUpper( WeightPtr w, long i, long upper )
+{
+	long		kappa, sum = 1, n = w->n, j, counts[kBlockSize];
+	char		counted = doGrowMultiples( w, i, upper );
+	
+	/* if the table's too small, we'll count the multiples ourselves */
+	if( !counted )
+		for( j = i + 1; j <= n; j++ )
+			doNewDivisibilityTest( w->tests + j - i - 1, w->k[j] );
+	
+	/* work through the \kappa */
+	for( kappa = 2; kappa <= upper - 1; kappa++ )
+	{
+		/* calculate the sum as it currently stands (looking the count up, or counting a block at a time) */
+		sum++;
+		if( counted )
+			sum -= w->multiples[kappa];
+		else
+		{
+			if( !((kappa - 2) % kBlockSize) )
+				doCountMultiples( w->tests, n - i, kappa, counts );
+			sum -= counts[(kappa - 2) % kBlockSize];
+		}
+		
+		/* check that the values are valid */
+		if( w->terminal )
+		{	/* the terminal case */
+			if( (kappa < upper - 2) && (sum > n - 1) )				upper = kappa + 2;
+			if( (kappa < upper - 3) && (sum > n - 2) )				upper = kappa + 3;
+			if( (sum < 2) && (kappa >= 2) && (kappa < upper - 2) )	upper = kappa + 2;
+		}
+		else
+		{	/* the canonical case */
+			if( (kappa < upper - 2) && ((sum > n) || !sum) )		upper = kappa + 2;
+		}
+	}
+	
+	/* return the bound we found */
+	MStat( w, w->stats->levels[i].kappaSteps += kappa - 2 );
+	return( upper );	
+}
+
+/* doNewDivisibilityTest -	call to set up a quick test of whether k divides a number */
+/*	Write k = d 2^t with d odd. Multiplication by the inverse of d (mod 2^64) maps the multiples of d below 2^64 onto
+	{0, ..., (2^64 - 1) / d}, and everything else above it; rotating right by t then does the same for k, since a
+	multiple of d is even enough exactly when its low t bits rotate off as zeros (Granlund and Montgomery).	*/
+static void doNewDivisibilityTest( DivisibilityPtr test, long k )
+{
+	unsigned long	d = (unsigned long)k >> __builtin_ctzl( k ), inverse = d;
+	int				i;
+	
+	/* Newton's method: d is its own inverse mod 8, and each step doubles the number of bits that are right */
+	for( i = 0; i < 5; i++ )	inverse *= 2 - d * inverse;
+	test->inverse = inverse;
+	test->limit = ~0UL / (unsigned long)k;
+	test->shift = __builtin_ctzl( k );
+}
+
+/* doCountMultiples -	call to count how many of the k-values divide each of first, ..., first + kBlockSize - 1 */
+/*	There's no division and no branch in the inner loop, so the compiler is free to run it across the lanes of
+	whatever vector instructions the target has; the test is exact, so nothing needs checking afterwards.	*/
+static void doCountMultiples( DivisibilityPtr tests, long numTests, long first, long *counts )
+{
+	long		j, b;
+	
+	for( b = 0; b < kBlockSize; b++ )	counts[b] = 0;
+	for( j = 0; j < numTests; j++ )
+	{
+		unsigned long	inverse = tests[j].inverse, limit = tests[j].limit;
+		int				shift = tests[j].shift;
+		
+		for( b = 0; b < kBlockSize; b++ )
+		{
+			unsigned long	x = (unsigned long)(first + b) * inverse;
+			
+			counts[b] += (((x >> shift) | (x << ((64 - shift) & 63))) <= limit);
+		}
 	}
-	
-	/* return the bound we found */
-	return( upper );	
 }
 
 /* doFinishCalculationCanonical -	call to check the weight is valid and output the k-values; canonical case */
 static void doFinishCalculationCanonical( WeightPtr w )
 {
-	long		h = 1, i, total = 0, lam;
+	long		h = w->lcms[0], lam;
 	
-	/* calculate the value of h */
-	for( i = 1; i <= w->n; i++ )	h = doFindLCM( w->k[i], h );
-	
-	/* calculate the sum \lambda_1 + ... + \lambda_n, in order to find \lambda_0 */
-	for( i = 1; i <= w->n; i++ )	total += h / w->k[i];
-	lam = h - total;
+	/* h is the LCM of k_1, ..., k_n, and \lambda_1 + ... + \lambda_n = h(1/k_1 + ... + 1/k_n), which gives us \lambda_0 */
+	MStat( w, w->stats->leaves++ );
+	lam = h - (h / w->sums[0].b) * w->sums[0].a;
 	
 	/* check whether the lambda_0 value is sensible */
-	if( lam < 1 )			return;
-	if( h % lam )			return;
-	if( lam > h / w->k[1] )	return;
+	if( lam < 1 )
+	{
+		MStat( w, w->stats->smallLambda++ );
+		return;
+	}
+	if( h % lam )
+	{
+		MStat( w, w->stats->lambdaNotDivisor++ );
+		return;
+	}
+	if( lam > h / w->k[1] )
+	{
+		MStat( w, w->stats->largeLambda++ );
+		return;
+	}
 	
 	/* all's appears well; we have our weights */
 	w->k[0] = h / lam;
-	if( doCheckSumValid( w, h ) )
+	if( doCheckSum( w, h ) )
 		doAddWeightToList( w, h );
 }
 
 /* doFinishCalculationTerminal -	call to check the weight is valid and output the k-values; terminal case */
 static void doFinishCalculationTerminal( WeightPtr w )
 {
-	long		h = 1, i, total = 0, lam;
+	long		h = w->lcms[2], lam;
 	
-	/* calculate the value of h */
-	for( i = 3; i <= w->n; i++ )	h = doFindLCM( w->k[i], h );
-	
-	/* calculate the sum \lambda_3 + ... + \lambda_n, in order to find \lambda_0, \lambda_1, and \lambda_2 */
-	for( i = 3; i <= w->n; i++ )	total += h / w->k[i];
-	lam = h - total;
+	/* h is the LCM of k_3, ..., k_n, and \lambda_3 + ... + \lambda_n = h(1/k_3 + ... + 1/k_n), which gives us
+	\lambda_0 + \lambda_1 + \lambda_2 */
+	MStat( w, w->stats->leaves++ );
+	lam = h - (h / w->sums[2].b) * w->sums[2].a;
 	
 	/* check whether the value of \lambda_0+\lambda_1+\lambda_2 is sensible */
-	if( lam < 3 )	return;
+	if( lam < 3 )
+	{
+		MStat( w, w->stats->smallLambda++ );
+		return;
+	}
 	
 	/* check through the possible \lambda_i, i = 0,1,2, outputting any possibilities we find */
 	doCalculate3Lambdas( w, h, lam );
@@ -373,191 +2263,649 @@ static void doFinishCalculationTerminal( WeightPtr w )
 static void doCalculate3Lambdas( WeightPtr w, long h, long lam )
 {
 	long		lambda2, max2;
+	DivisorsPtr	d;
+	MemoPtr		memo = kFalse;
+	char		found = kFalse;
 	
 	/* establish upper bounds on \lambda_2 */
 	max2 = lam - 2;
 	if( max2 > h / w->k[3] )	max2 = h / w->k[3];
 	
-	/* now check each possible value of \lambda_2 in turn */
-	for( lambda2 = max2; lambda2 >= lam / 3; lambda2-- )
-		if( !(h % lambda2) )	/* we require \lambda_2 | h */
+	/* which \lambda_i pass the tests below (other than the sum check) depends only on h, lam and max2, so if we've
+	seen these before and nothing passed, there's nothing to do */
+	if( w->memo )
+	{
+		memo = doFindMemo( w, h, lam, max2 );
+		if( (memo->h == h) && (memo->lam == lam) && (memo->max2 == max2) )
 		{
-			long		lambda1, max1;
-			
-			/* estabilsh upper bounds on \lambda_1 */
-			max1 = lam - lambda2 - 1;
-			if( max1 > lambda2 )		max1 = lambda2;
+			w->memoHits++;
+			return;
+		}
+		w->memoMisses++;
+	}
+	d = doFindDivisors( w->cache, h );
+	
+	/* now check each possible value of \lambda_2 in turn (we require \lambda_2 | h, so we step through the divisors) */
+	for( lambda2 = doPrevDivisor( d, h, max2 ); lambda2 >= lam / 3; lambda2 = doPrevDivisor( d, h, lambda2 - 1 ) )
+	{
+		long		lambda1, max1;
+		
+		/* estabilsh upper bounds on \lambda_1 */
+		max1 = lam - lambda2 - 1;
+		if( max1 > lambda2 )		max1 = lambda2;
+		
+		/* now check each possible value of \lambda_1 in turn (again, we require \lambda_1 | h) */
+		for( lambda1 = doPrevDivisor( d, h, max1 ); lambda1 >= (lam - lambda2) / 2; lambda1 = doPrevDivisor( d, h, lambda1 - 1 ) )
+		{
+			long		lambda0 = lam - lambda2 - lambda1;
 			
-			/* now check each possible value of \lambda_1 in turn */
-			for( lambda1 = max1; lambda1 >= (lam - lambda2) / 2; lambda1-- )
-				if( !(h % lambda1) )	/* we require \lambda_1 | h */
+			/* check that the value of \lambda_0 is valid */
+			if( (lambda0 <= lambda1) && (lambda0 > 0) && !(h % lambda0) )
+			{
+				MStat( w, w->stats->triples++ );
+				
+				/* calculate k_0, k_1, and k_2 */
+				w->k[0] = h / lambda0;
+				w->k[1] = h / lambda1;
+				w->k[2] = h / lambda2;
+				
+				/* check that the k-values are valid */
+				if( (w->k[2] > w->n) && (w->k[1] > w->n + 1) && (w->k[0] > w->n + 1) )
 				{
-					long		lambda0 = lam - lambda2 - lambda1;
-					
-					/* check that the value of \lambda_0 is valid */
-					if( (lambda0 <= lambda1) && (lambda0 > 0) && !(h % lambda0) )
-					{
-						/* calculate k_0, k_1, and k_2 */
-						w->k[0] = h / lambda0;
-						w->k[1] = h / lambda1;
-						w->k[2] = h / lambda2;
-						
-						/* check that the k-values are valid */
-						if( (w->k[2] > w->n) && (w->k[1] > w->n + 1) && (w->k[0] > w->n + 1) && doCheckSumValid( w, h ) )							
-							doAddWeightToList( w, h );	/* we've found a possible weight */
-					}
+					found = kTrue;
+					if( doCheckSum( w, h ) )
+						doAddWeightToList( w, h );	/* we've found a possible weight */
 				}
+				else
+					MStat( w, w->stats->smallKValues++ );
+			}
+		}
+	}
+	
+	/* remember a failure (replacing whatever was there) */
+	if( memo && !found )
+	{
+		memo->h = h;
+		memo->lam = lam;
+		memo->max2 = max2;
+	}
+}
+
+/* doNewMemo -	call to allocate a memo table with (at most) the given number of entries */
+static char doNewMemo( WeightPtr w, long maxEntries )
+{
+	long		size = 1;
+	
+	while( 2 * size <= maxEntries )		size *= 2;
+	if( !(w->memo = (MemoPtr)calloc( size, sizeof( MemoRec ) )) )
+		return( kFalse );
+	w->memoSize = size;
+	
+	return( kTrue );
+}
+
+/* doFindMemo -	call to find the memo table entry for the given terminal leaf (it may hold some other leaf) */
+static MemoPtr doFindMemo( WeightPtr w, long h, long lam, long max2 )
+{
+	unsigned long	hash = (unsigned long)h * 0x9E3779B97F4A7C15UL;
+	
+	hash = (hash ^ (unsigned long)lam) * 0xC2B2AE3D27D4EB4FUL;
+	hash = (hash ^ (unsigned long)max2) * 0x165667B19E3779F9UL;
+	
+	return( w->memo + ((hash >> 32) & (w->memoSize - 1)) );
+}
+
+/* doFindDivisors -	call to find the divisors of h, in increasing order (returns false if we run out of memory) */
+/*	h is factorised by trial division by the primes up to its square root (and, past the largest sieve, by the odd
+	numbers), and the list is cached, since neighbouring leaves of the search often share the same h.	*/
+static DivisorsPtr doFindDivisors( CachePtr c, long h )
+{
+	DivisorsPtr	d = c->divisorCache + (h % kDivisorCacheSize);
+	long		*divisors, numDivisors = 1, maxDivisors = 1, m = h, i, j, e, count, p, q;
+	
+	if( (d->h == h) && d->divisors )
+		return( d );
+	if( !doGrowPrimes( c, h ) )
+		return( kFalse );
+	
+	/* find an upper bound on the number of divisors, then generate them a prime power at a time */
+	for( i = 0, q = c->primeLimit | 1; ; )
+	{
+		if( i < c->numPrimes )
+		{
+			if( c->primes[i] > m / c->primes[i] )
+				break;
+			p = c->primes[i++];
+		}
+		else if( q <= m / q )
+		{
+			p = q;
+			q += 2;
+		}
+		else
+			break;
+		if( !(m % p) )
+		{
+			for( e = 0; !(m % p); e++ )		m /= p;
+			maxDivisors *= e + 1;
+		}
+	}
+	if( m > 1 )		maxDivisors *= 2;
+	if( !(divisors = (long *)malloc( sizeof( long ) * maxDivisors )) )
+		return( kFalse );
+	divisors[0] = 1;
+	for( m = h, i = 0, q = c->primeLimit | 1; m > 1; )
+	{
+		/* the next prime factor (what's left once we pass the square root is itself prime) */
+		if( (i < c->numPrimes) && (c->primes[i] <= m / c->primes[i]) )
+		{
+			if( m % (p = c->primes[i++]) )
+				continue;
 		}
+		else if( (i >= c->numPrimes) && (q <= m / q) )
+		{
+			p = q;
+			q += 2;
+			if( m % p )
+				continue;
+		}
+		else
+			p = m;
+		
+		/* multiply the divisors so far by each power of p */
+		for( count = numDivisors, e = 1; !(m % p); m /= p, e *= p )
+			for( j = 0; j < numDivisors; j++ )
+				divisors[count++] = divisors[j] * e * p;
+		numDivisors = count;
+	}
+	qsort( (void *)divisors, numDivisors, sizeof( long ), doCompareLongs );
+	
+	/* and cache them */
+	if( d->divisors )	free( (void *)d->divisors );
+	d->h = h;
+	d->divisors = divisors;
+	d->numDivisors = numDivisors;
+	
+	return( d );
+}
+
+/* doGrowPrimes -	call to make sure we have all the primes up to the square root of h (or up to kMaxPrimeLimit) */
+static char doGrowPrimes( CachePtr c, long h )
+{
+	long		limit = c->primeLimit ? c->primeLimit : kMinPrimeLimit, *primes, numPrimes = 0, i, j;
+	char		*composite;
+	
+	if( c->primeLimit && ((c->primeLimit > h / c->primeLimit) || (c->primeLimit >= kMaxPrimeLimit)) )
+		return( kTrue );
+	while( (limit <= h / limit) && (limit < kMaxPrimeLimit) )		limit *= 2;
+	
+	/* sieve */
+	if( !(composite = (char *)calloc( limit, sizeof( char ) )) )
+		return( kFalse );
+	for( i = 2; i < limit; i++ )
+		if( !composite[i] )
+		{
+			numPrimes++;
+			for( j = i * i; j < limit; j += i )		composite[j] = kTrue;
+		}
+	if( !(primes = (long *)malloc( sizeof( long ) * numPrimes )) )
+	{
+		free( (void *)composite );
+		return( kFalse );
+	}
+	for( numPrimes = 0, i = 2; i < limit; i++ )
+		if( !composite[i] )		primes[numPrimes++] = i;
+	free( (void *)composite );
+	
+	if( c->primes )		free( (void *)c->primes );
+	c->primes = primes;
+	c->numPrimes = numPrimes;
+	c->primeLimit = limit;
+	
+	return( kTrue );
+}
+
+/* doNewCache -	call to allocate an (empty) cache of primes and divisors */
+static CachePtr doNewCache( void )
+{
+	CachePtr	c;
+	
+	if( !(c = (CachePtr)calloc( 1, sizeof( CacheRec ) )) )
+		return( kFalse );
+	if( !(c->divisorCache = (DivisorsPtr)calloc( kDivisorCacheSize, sizeof( DivisorsRec ) )) )
+	{
+		free( (void *)c );
+		return( kFalse );
+	}
+	
+	return( c );
+}
+
+/* doDisposeCache -	call to free the memory of a cache */
+static void doDisposeCache( CachePtr c )
+{
+	long		i;
+	
+	for( i = 0; i < kDivisorCacheSize; i++ )
+		if( c->divisorCache[i].divisors )	free( (void *)c->divisorCache[i].divisors );
+	free( (void *)c->divisorCache );
+	if( c->primes )		free( (void *)c->primes );
+	free( (void *)c );
+}
+
+/* doPrevDivisor -	call to find the largest divisor of h no bigger than x (or 0 if there isn't one) */
+/*	We use the list of divisors if we have one; otherwise we fall back on trial division.	*/
+static long doPrevDivisor( DivisorsPtr d, long h, long x )
+{
+	long		lo = 0, hi, mid;
+	
+	if( !d )
+	{
+		for( ; x > 0; x-- )
+			if( !(h % x) )	return( x );
+		return( 0 );
+	}
+	
+	/* binary search for the last divisor <= x */
+	if( (x < 1) || !d->numDivisors )
+		return( 0 );
+	hi = d->numDivisors - 1;
+	if( d->divisors[hi] <= x )
+		return( d->divisors[hi] );
+	while( hi - lo > 1 )
+	{
+		mid = (lo + hi) / 2;
+		if( d->divisors[mid] <= x )		lo = mid;
+		else							hi = mid;
+	}
+	
+	return( d->divisors[lo] );
+}
+
+/* doCompareLongs -	call to compare two longs */
+static int doCompareLongs( const void *a, const void *b )
+{
+	return( (*(long *)a > *(long *)b) - (*(long *)a < *(long *)b) );
 }
 
 /* doCheckSumValid -	call to check that s(\kappa) and \Sigma(\kappa) are behaving as we expect */
+/*	s(\kappa) is zero unless \kappa is a multiple of some k_i, so we merge the multiples of the k_i and only stop at
+	those \kappa (and at 2, h-2 and h-1, where the conditions change). In between, \Sigma goes up by one each time,
+	so we only need to check its first and last values there.	*/
 static char doCheckSumValid( WeightPtr w, long h )
 {
-	long		kappa, sum = 1;
+	long		kappa = 1, sum = 1, n = w->n, event, s, len, i;
+	long		*k = w->k, *next = w->nextMultiple;
 	
-	/* step through all \kappa\in {1, ... ,h-1} calculating the s value and sum */
-	for( kappa = 2; kappa < h; kappa++ )
+	/* the first multiples (every k_i is at least 2) */
+	for( i = 0; i <= n; i++ )	next[i] = k[i];
+	
+	/* step through all \kappa\in {1, ... ,h-1} */
+	while( kappa < h - 1 )
 	{
-		long		s = 0, i;
-		
-		/* calculate s(\kappa) */
-		for( i = 0; i <= w->n; i++ )
-			if( !(kappa % w->k[i]) )	s++;
+		/* find the next \kappa we have to stop at */
+		event = h - 1;
+		if( (kappa < h - 2) && (h - 2 > 1) )	event = h - 2;
+		if( kappa < 2 )							event = 2;
+		for( i = 0; i <= n; i++ )
+			event = (next[i] < event) ? next[i] : event;
 		
-		/* calculate \Sigma(\kappa) */
-		sum = sum + 1 - s;
+		/* the stretch up to it lies in {3, ..., h-3}, with s(\kappa) = 0 (which is allowed, since n > 2 in the terminal case) */
+		if( (len = event - kappa - 1) > 0 )
+		{
+			if( w->terminal )
+			{	/* the terminal case */
+				if( (sum + len > n - 2) || (sum + 1 < 2) )				return( kFalse );
+			}
+			else
+			{	/* the canonical case */
+				if( (sum + len > n) || ((sum + 1 <= 0) && (sum + len >= 0)) )	return( kFalse );
+			}
+			sum += len;
+		}
 		
-		/* check that the values are valid */
-		if( w->terminal )
-		{	/* the terminal case */
-			if( s > w->n - 3 )									return( kFalse );
-			if( (kappa == 2) && (s > 0) )						return( kFalse );
-			if( (kappa <= h - 3) && (sum > w->n - 2) )			return( kFalse );
-			if( (kappa == h - 2) && (sum > w->n - 1) )			return( kFalse );
-			if( (sum < 2) && (kappa >= 2) && (kappa <= h - 2) )	return( kFalse );
+		/* calculate s(\kappa) and \Sigma(\kappa) at the event, and check them */
+		for( s = 0, i = 0; i <= n; i++ )
+		{
+			long		hit = (next[i] == event);
+			
+			s += hit;
+			next[i] += k[i] & -hit;
 		}
-		else
-		{	/* the canonical case */
-			if( s > w->n - 1 )									return( kFalse );
-			if( (kappa <= h - 2) && ((sum > w->n) || !sum) )	return( kFalse );
+		sum = sum + 1 - s;
+		MStat( w, w->stats->events++ );
+		if( !doCheckKappa( w, h, event, s, sum ) )
+			return( kFalse );
+		kappa = event;
+	}
+	
+	return( kTrue );
+}
+
+/* doCheckKappa -	call to check the values of s(\kappa) and \Sigma(\kappa) at the given \kappa */
+MInline char doCheckKappa( WeightPtr w, long h, long kappa, long s, long sum )
+{
+	long		n = w->n;
+	
+	if( w->terminal )
+	{	/* the terminal case */
+		if( s > n - 3 )										return( kFalse );
+		if( (kappa == 2) && (s > 0) )						return( kFalse );
+		if( (kappa <= h - 3) && (sum > n - 2) )				return( kFalse );
+		if( (kappa == h - 2) && (sum > n - 1) )				return( kFalse );
+		if( (sum < 2) && (kappa >= 2) && (kappa <= h - 2) )	return( kFalse );
+	}
+	else
+	{	/* the canonical case */
+		if( s > n - 1 )										return( kFalse );
+		if( (kappa <= h - 2) && ((sum > n) || !sum) )		return( kFalse );
+	}
+	
+	return( kTrue );
+}
+
+/* doRunCheck -	call to run the searches that finish quickly, and check the weights they find against those known to be right */
+/*	Rather than keep the lists themselves, we keep the number of weights and a fingerprint of each list, which doesn't
+	depend on the order the weights were found in (P^n, added by hand in the terminal case, is counted but isn't part of
+	the fingerprint). The times, the nodes visited, and the rate at which weights were
+	found are written to the named file (if any) as JSON, so that a slower version shows up as readily as a wrong one.
+	The terminal lists in dimensions 3 to 5 hold only a few weights, so those in 6 to 8 (which take moments) are checked too.
+	The program exits with EXIT_SUCCESS only if every list was right.	*/
+static char doRunCheck( char *name )
+{
+	static const struct
+	{
+		long			n;
+		char			terminal;
+		long			numFound;
+		unsigned long	fingerprint;
+	}				known[] = { { 2, kFalse, 3, 0x2a18b065ea5d6f1bUL }, { 3, kFalse, 14, 0x52c457f7fa3f5788UL },
+						{ 4, kFalse, 147, 0xc90094d917f132d7UL }, { 5, kFalse, 3462, 0x5861e4738392f76aUL },
+						{ 3, kTrue, 1, 0x0UL }, { 4, kTrue, 2, 0x70b31ce967b32805UL }, { 5, kTrue, 4, 0xab32f37509fb1967UL },
+						{ 6, kTrue, 18, 0xfd93b4c74ecf9201UL }, { 7, kTrue, 135, 0xb68c400b25d2df2eUL },
+						{ 8, kTrue, 1342, 0x4466f1dac3b8b3a7UL } };
+	CachePtr		cache;
+	WeightPtr		w;
+	ResultsRec		results;
+	struct timespec	start, stop;
+	FILE			*file = kFalse;
+	unsigned long	fingerprint;
+	double			t;
+	char			passed = kTrue, right;
+	int				i, num = sizeof( known ) / sizeof( known[0] );
+	
+	if( !(cache = doNewCache()) )
+	{
+		printf( "Not enough memory for a cache of primes and divisors!\n" );
+		return( kFalse );
+	}
+	if( name && !(file = fopen( name, "w" )) )
+	{
+		printf( "Error! Unable to create file '%s'.\n", name );
+		passed = kFalse;
+	}
+	if( file )	fprintf( file, "{\n\t\"checks\": [\n" );
+	printf( "Dimension  Singularities  Weights   Expected      Time       Nodes  Weights/s\n" );
+	for( i = 0; i < num; i++ )
+	{
+		/* run the search, collecting the weights */
+		if( !(w = doNewWeight( known[i].n, known[i].terminal, cache, kFalse )) )
+		{
+			passed = kFalse;
+			break;
 		}
+		memset( (void *)&results, 0, sizeof( ResultsRec ) );
+		w->results = &results;
+		clock_gettime( CLOCK_MONOTONIC, &start );
+		doCalculatek( w, w->n );
+		clock_gettime( CLOCK_MONOTONIC, &stop );
+		t = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
 		
+		/* and compare them */
+		fingerprint = doFingerprint( results.values, results.length, w->n );
+		right = !results.failed && !w->overflow && (w->numFound == known[i].numFound) && (fingerprint == known[i].fingerprint);
+		if( !right )	passed = kFalse;
+		printf( "%9ld  %-13s  %7ld  %9ld  %8.3fs  %10ld  %9.0f  %s\n", w->n, w->terminal ? "terminal" : "canonical", w->numFound,
+			known[i].numFound, t, w->nodes, t > 0 ? w->numFound / t : 0, right ? "ok" : "WRONG" );
+		if( file )
+			fprintf( file, "\t\t{ \"dimension\": %ld, \"terminal\": %s, \"weights\": %ld, \"expected\": %ld, "
+				"\"fingerprint\": \"%016lx\", \"passed\": %s, \"time\": %.6f, \"nodes\": %ld, \"weightsPerSecond\": %.1f }%s\n",
+				w->n, w->terminal ? "true" : "false", w->numFound, known[i].numFound, fingerprint, right ? "true" : "false", t,
+				w->nodes, t > 0 ? w->numFound / t : 0, i < num - 1 ? "," : "" );
+		free( (void *)results.values );
+		doDisposeWeight( w );
+	}
+	if( file )
+	{
+		fprintf( file, "\t],\n\t\"passed\": %s\n}\n", passed ? "true" : "false" );
+		fclose( file );
 	}
+	printf( "%s\n", passed ? "All the weights were as expected." : "Error! Some of the weights were not as expected." );
+	doDisposeCache( cache );
 	
-	return( kTrue );
+	return( passed );
+}
+
+/* doFingerprint -	call to fingerprint a list of weights of dimension n, each as \lambda_0, ..., \lambda_n, h */
+/*	Each weight is hashed (FNV-1a, over its values), and the hashes summed, so the order of the list doesn't matter.	*/
+static unsigned long doFingerprint( long *values, long length, long n )
+{
+	unsigned long	sum = 0, hash;
+	long			i, j;
+	
+	for( i = 0; i < length; i += n + 2 )
+	{
+		hash = 14695981039346656037UL;
+		for( j = 0; j < n + 2; j++ )
+			hash = (hash ^ (unsigned long)values[i + j]) * 1099511628211UL;
+		sum += hash;
+	}
+	
+	return( sum );
 }
 
-/* doLowestForm -	call to put the fraction in its lowest form */
-static void doLowestForm( fnum *fr )
+/* doAddFraction -	call to set result = x + p/q, in lowest form (returns false if it won't fit in a long) */
+/*	x is in lowest form and q > 0. The sum is worked out in 128 bits, so it can't overflow before it's reduced.	*/
+static char doAddFraction( fnum *result, fnum *x, long p, long q )
 {
-	long			test = 2, neg = 1;
+	wide		a, b = (wide)x->b * (wide)q, hcf;
+	char		neg;
+	__int128	num = (__int128)x->a * q + (__int128)p * x->b;
 	
 	/* get the -'ve tidy */
-	if( fr->b < 0 )			{ fr->b *= -1; neg *= -1; }
-	if( fr->a < 0 )			{ fr->a *= -1; neg *= -1; }
+	if( (neg = (num < 0)) )		num = -num;
+	a = (wide)num;
 	
-	/* clear out the obvious possibilities */
-	if( !fr->a )			{ fr->b = 1; return; }
-	if( !(fr->a % fr->b) )	{ fr->a /= (neg * fr->b); fr->b = 1; return; }
-		
-	/* start clearing the cofactors */
-	while( (test <= fr->a) && (test <= fr->b) )
+	/* clear out the obvious possibility, and otherwise divide through by the HCF */
+	if( !a )
 	{
-		if( !(fr->a % test) && !(fr->b % test) )	{ fr->a /= test; fr->b /= test; }
-		else	test = doNextPrime( test );
+		result->a = 0;
+		result->b = 1;
+		return( kTrue );
 	}
-	fr->a *= neg;
+	hcf = doFindWideHCF( a, b );
+	a /= hcf;
+	b /= hcf;
+	if( (a > LONG_MAX) || (b > LONG_MAX) )
+		return( kFalse );
+	result->a = neg ? -(long)a : (long)a;
+	result->b = (long)b;
+	
+	return( kTrue );
 }
 
 /* doFindHCF -	call to calculate the HCF of two integers */
+/*	Stein's binary algorithm: only shifts and subtractions, which are much cheaper than division.	*/
 static long doFindHCF( long a, long b )
 {
-	long	found = 1, test = 2;
+	unsigned long	u, v, t;
+	int				shift;
 	
 	/* get the -'ve tidy */
-	if( a < 0 )			a*= -1;
+	if( a < 0 )			a *= -1;
 	if( b < 0 )			b *= -1;
 	
 	/* do some obvious checks */
 	if( !a )			return( b );
 	if( !b )			return( a );
-	if( !(a % b) )		return( b );
-	if( !(b % a) )		return( a );
-	
-	/* start checking the primes */
-	while( (test < a) && (test < b) )
-	{
-		if( !(a % test) && !(b % test) )		{ a /= test; b /= test; found *= test; }
-		else	test = doNextPrime( test );
-	}
-	
-	return( found );
-}
-
-/* doFindLCM -	call to calculate the LCM of two integers */
-static long doFindLCM( long a, long b )
-{
-	return( (a * b) / doFindHCF( a, b ) );
-}
-
-/* doNextPrime -	call to get the next prime (or else the next odd numer) */
-/*	Prime number list from "The Prime Pages", http://primes.utm.edu/	*/
-static long doNextPrime( long p )
-{
-	switch( p )
-	{
-		case 2:		p = 3;		break;	case 3:		p = 5;		break;	case 5:		p = 7;		break;
-		case 7:		p = 11;		break;	case 11:	p = 13;		break;	case 13:	p = 17;		break;
-		case 17:	p = 19;		break;	case 19:	p = 23;		break;	case 23:	p = 29;		break;
-		case 29:	p = 31;		break;	case 31:	p = 37;		break;	case 37:	p = 41;		break;
-		case 41:	p = 43;		break;	case 43:	p = 47;		break;	case 47:	p = 53;		break;
-		case 53:	p = 59;		break;	case 59:	p = 61;		break;	case 61:	p = 67;		break;
-		case 67:	p = 71;		break;	case 71:	p = 73;		break;	case 73:	p = 79;		break;
-		case 79:	p = 83;		break;	case 83:	p = 89;		break;	case 89:	p = 97;		break;
-		case 97:	p = 101;	break;	case 101:	p = 103;	break;	case 103:	p = 107;	break;
-		case 107:	p = 109;	break;	case 109:	p = 113;	break;	case 113:	p = 127;	break;
-		case 127:	p = 131;	break;	case 131:	p = 137;	break;	case 137:	p = 139;	break;
-		case 139:	p = 149;	break;	case 149:	p = 151;	break;	case 151:	p = 157;	break;
-		case 157:	p = 163;	break;	case 163:	p = 167;	break;	case 167:	p = 173;	break;
-		case 173:	p = 179;	break;	case 179:	p = 181;	break;	case 181:	p = 191;	break;
-		case 191:	p = 193;	break;	case 193:	p = 197;	break;	case 197:	p = 199;	break;
-		case 199:	p = 211;	break;	case 211:	p = 223;	break;	case 223:	p = 227;	break;
-		case 227:	p = 229;	break;	case 229:	p = 233;	break;	case 233:	p = 239;	break;
-		case 239:	p = 241;	break;	case 241:	p = 251;	break;	case 251:	p = 257;	break;
-		case 257:	p = 263;	break;	case 263:	p = 269;	break;	case 269:	p = 271;	break;
-		case 271:	p = 277;	break;	case 277:	p = 281;	break;	case 281:	p = 283;	break;
-		case 283:	p = 293;	break;	case 293:	p = 307;	break;	case 307:	p = 311;	break;
-		case 311:	p = 313;	break;	case 313:	p = 317;	break;	case 317:	p = 331;	break;
-		case 331:	p = 337;	break;	case 337:	p = 347;	break;	case 347:	p = 349;	break;
-		case 349:	p = 353;	break;	case 353:	p = 359;	break;	case 359:	p = 367;	break;
-		case 367:	p = 373;	break;	case 373:	p = 379;	break;	case 379:	p = 383;	break;
-		case 383:	p = 389;	break;	case 389:	p = 397;	break;	case 397:	p = 401;	break;
-		case 401:	p = 409;	break;	case 409:	p = 419;	break;	case 419:	p = 421;	break;
-		case 421:	p = 431;	break;	case 431:	p = 433;	break;	case 433:	p = 439;	break;
-		case 439:	p = 443;	break;	case 443:	p = 449;	break;	case 449:	p = 457;	break;
-		case 457:	p = 461;	break;	case 461:	p = 463;	break;	case 463:	p = 467;	break;
-		case 467:	p = 479;	break;	case 479:	p = 487;	break;	case 487:	p = 491;	break;
-		case 491:	p = 499;	break;	case 499:	p = 503;	break;	case 503:	p = 509;	break;
-		case 509:	p = 521;	break;	case 521:	p = 523;	break;	case 523:	p = 541;	break;
-		case 541:	p = 547;	break;	case 547:	p = 557;	break;	case 557:	p = 563;	break;
-		case 563:	p = 569;	break;	case 569:	p =	571;	break;	case 571:	p = 577;	break;
-		case 577:	p = 587;	break;	case 587:	p = 593;	break;	case 593:	p = 599;	break;
-		case 599:	p = 601;	break;	case 601:	p = 607;	break;	case 607:	p = 613;	break;
-		case 613:	p = 617;	break;	case 617:	p = 619;	break;	case 619:	p = 631;	break;
-		case 631:	p = 641;	break;	case 641:	p = 643;	break;	case 643:	p = 647;	break;
-		case 647:	p = 653;	break;	case 653:	p = 659;	break;	case 659:	p = 661;	break;
-		case 661:	p = 673;	break;	case 673:	p = 677;	break;	case 677:	p = 683;	break;
-		case 683:	p = 691;	break;	case 691:	p = 701;	break;	case 701:	p = 709;	break;
-		case 709:	p = 719;	break;	case 719:	p = 727;	break;	case 727:	p = 733;	break;
-		case 733:	p = 739;	break;	case 739:	p = 743;	break;	case 743:	p = 751;	break;
-		case 751:	p = 757;	break;	case 757:	p = 761;	break;	case 761:	p = 769;	break;
-		case 769:	p = 773;	break;	case 773:	p = 787;	break;	case 787:	p = 797;	break;
-		case 797:	p = 809;	break;	case 809:	p = 811;	break;	case 811:	p = 821;	break;
-		case 821:	p = 823;	break;	case 823:	p = 827;	break;	case 827:	p = 829;	break;
-		case 829:	p = 839;	break;	case 839:	p = 853;	break;	case 853:	p = 857;	break;
-		case 857:	p = 859;	break;	case 859:	p = 863;	break;	case 863:	p = 877;	break;
-		default:	p += 2;		break;
-	}
-	
-	return( p );
+	
+	/* take out the common powers of 2, then keep subtracting the smaller (odd) number from the larger */
+	u = (unsigned long)a;
+	v = (unsigned long)b;
+	shift = __builtin_ctzl( u | v );
+	u >>= __builtin_ctzl( u );
+	do
+	{
+		v >>= __builtin_ctzl( v );
+		if( u > v )			{ t = u; u = v; v = t; }
+		v -= u;
+	} while( v );
+	
+	return( (long)(u << shift) );
+}
+
+/* doFindWideHCF -	call to calculate the HCF of two (unsigned, 128-bit) integers */
+static wide doFindWideHCF( wide a, wide b )
+{
+	wide		t;
+	int			shift = 0;
+	
+	/* do some obvious checks, and use the quicker version if we can */
+	if( !a )			return( b );
+	if( !b )			return( a );
+	if( (a <= LONG_MAX) && (b <= LONG_MAX) )
+		return( (wide)doFindHCF( (long)a, (long)b ) );
+	
+	/* as above */
+	while( !((a | b) & 1) )		{ a >>= 1; b >>= 1; shift++; }
+	while( !(a & 1) )			a >>= 1;
+	do
+	{
+		while( !(b & 1) )		b >>= 1;
+		if( a > b )				{ t = a; a = b; b = t; }
+		b -= a;
+	} while( b );
+	
+	return( a << shift );
+}
+
+/* doFindLCM -	call to calculate the LCM of two (positive) integers (returns false if it won't fit in a long) */
+static char doFindLCM( long a, long b, long *lcm )
+{
+	wide		result = (wide)(a / doFindHCF( a, b )) * (wide)b;
+	
+	if( result > LONG_MAX )
+		return( kFalse );
+	*lcm = (long)result;
+	
+	return( kTrue );
+}
+
+/* doCheckSum -	call to check the sums for the k-values (collecting statistics, if we are) */
+MInline char doCheckSum( WeightPtr w, long h )
+{
+#ifdef kInstrument
+	if( w->stats )
+	{
+		double		start = doNow();
+		char		valid = doCheckSumValid( w, h );
+		
+		w->stats->sumChecks++;
+		if( !valid )	w->stats->sumFailures++;
+		w->stats->sumTime += doNow() - start;
+		return( valid );
+	}
+#endif
+	return( doCheckSumValid( w, h ) );
+}
+
+#ifdef kInstrument
+/* doNewStats -	call to start collecting statistics on the search */
+static char doNewStats( WeightPtr w )
+{
+	if( !(w->stats = (StatsPtr)calloc( 1, sizeof( StatsRec ) )) )
+		return( kFalse );
+	if( !(w->stats->levels = (LevelStatsPtr)calloc( w->n + 1, sizeof( LevelStatsRec ) )) )
+	{
+		free( (void *)w->stats );
+		w->stats = kFalse;
+		return( kFalse );
+	}
+	
+	return( kTrue );
+}
+
+/* doMergeStats -	call to add the statistics of a thread's search to those of the whole */
+static void doMergeStats( StatsPtr to, StatsPtr from, long n )
+{
+	long		i;
+	
+	for( i = 0; i <= n; i++ )
+	{
+		to->levels[i].nodes += from->levels[i].nodes;
+		to->levels[i].fullSums += from->levels[i].fullSums;
+		to->levels[i].overflows += from->levels[i].overflows;
+		to->levels[i].emptyBound += from->levels[i].emptyBound;
+		to->levels[i].emptyTightened += from->levels[i].emptyTightened;
+		to->levels[i].terminalRule += from->levels[i].terminalRule;
+		to->levels[i].widthBound += from->levels[i].widthBound;
+		to->levels[i].widthTightened += from->levels[i].widthTightened;
+		to->levels[i].kappaSteps += from->levels[i].kappaSteps;
+		to->levels[i].time += from->levels[i].time;
+		to->levels[i].tightenTime += from->levels[i].tightenTime;
+	}
+	to->leaves += from->leaves;
+	to->smallLambda += from->smallLambda;
+	to->lambdaNotDivisor += from->lambdaNotDivisor;
+	to->largeLambda += from->largeLambda;
+	to->triples += from->triples;
+	to->smallKValues += from->smallKValues;
+	to->sumChecks += from->sumChecks;
+	to->sumFailures += from->sumFailures;
+	to->events += from->events;
+	to->sumTime += from->sumTime;
+}
+
+/* doWriteStats -	call to write the statistics on the search to the named file, as JSON */
+/*	The levels are listed from k_n down. A level's time covers its whole subtree, and in a parallel run the times are
+	summed over the threads (so they can add up to more than the run took).	*/
+static void doWriteStats( WeightPtr w, char *name )
+{
+	StatsPtr	st = w->stats;
+	FILE		*file;
+	long		i;
+	
+	if( !(file = fopen( name, "w" )) )
+	{
+		printf( "Error! Unable to create file '%s'.\n", name );
+		return;
+	}
+	fprintf( file, "{\n\t\"dimension\": %ld,\n\t\"terminal\": %s,\n\t\"weights\": %ld,\n\t\"levels\": [\n", w->n,
+		w->terminal ? "true" : "false", w->numFound );
+	for( i = w->n; i >= 0; i-- )
+	{
+		LevelStatsPtr	l = st->levels + i;
+		
+		fprintf( file, "\t\t{ \"level\": %ld, \"nodes\": %ld, \"fullSums\": %ld, \"overflows\": %ld, \"emptyBound\": %ld, "
+			"\"emptyTightened\": %ld, \"terminalRule\": %ld, \"widthBound\": %ld, \"widthTightened\": %ld, \"kappaSteps\": %ld, "
+			"\"time\": %.6f, \"tightenTime\": %.6f }%s\n", i, l->nodes, l->fullSums, l->overflows, l->emptyBound,
+			l->emptyTightened, l->terminalRule, l->widthBound, l->widthTightened, l->kappaSteps, l->time, l->tightenTime,
+			i ? "," : "" );
+	}
+	fprintf( file, "\t],\n\t\"leaves\": { \"reached\": %ld, \"smallLambda\": %ld, \"lambdaNotDivisor\": %ld, \"largeLambda\": %ld, "
+		"\"triples\": %ld, \"smallKValues\": %ld },\n", st->leaves, st->smallLambda, st->lambdaNotDivisor, st->largeLambda,
+		st->triples, st->smallKValues );
+	fprintf( file, "\t\"sumChecks\": { \"calls\": %ld, \"failures\": %ld, \"events\": %ld, \"time\": %.6f }\n}\n",
+		st->sumChecks, st->sumFailures, st->events, st->sumTime );
+	fclose( file );
+}
+
+/* doNow -	call to read the clock (in seconds) */
+static double doNow( void )
+{
+	struct timespec		t;
+	
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return( t.tv_sec + t.tv_nsec / 1e9 );
 }
+#endif
@@ -6,59 +6,198 @@ http://www.math.unb.ca/~kasprzyk/
 This program lists the coefficients of x^i in the expansion of
 	(1 + x)(1 + x^2)...(1 + x^k)
 for k = 1,..., kval, where 'kval' is defined by the user.
+The coefficients are calculated exactly, however large they become, either with
+multi-limb integers, or (given "-modular") modulo enough primes to put them back together
+again by the Chinese Remainder Theorem; "-threads t" shares the primes between t threads.
+Given "-series", only the coefficients for k = kval are listed, found as the exponential of
+the logarithm of the product (a power series which is easily written down), modulo primes.
+Since the coefficients are palindromic, "-half" keeps only the first half of them, in a
+single table which is updated in place (a quarter of the memory, using limbs).
+Given "-query", it instead reads pairs "k m" (or "k m1-m2", for a range of m), and gives
+just the coefficient of x^m for that k, multiplying out only as far as x^m.
 ------------------------------------------------------------------------------------------
 */
 
 /* standard libraries */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 /* useful constants */
 #define	kRuleOff		"---------------------------------------------\n\n"
 #define	kTrue		1
 #define	kFalse		0
+#define	kLimbBits	64						/* the bits in each limb of a coefficient */
+#define	kChunk		10000000000000000000UL	/* the power of 10 a coefficient is written out in pieces of */
+#define	kPrimeBits	61						/* the primes are all larger than 2^61 (and smaller than 2^62) */
+#define	kMaxThreads	64						/* the most threads the primes can be shared between */
+#define	kLimbs		0						/* the ways of calculating the coefficients: with limbs, */
+#define	kModular	1						/* modulo primes, */
+#define	kSeries		2						/* or (for k = kval alone) by power series, modulo primes */
+#define	kCrossCheck	500						/* the largest kval for which the power series are checked against the recurrence */
+#define	kMaxQueryK	6074000999UL			/* the largest k a query can have (so that k(k + 1)/2 fits in an unsigned long) */
+
+/* the coefficients */
+/*	Every coefficient of (1 + x)...(1 + x^k) is less than 2^k, so we hold each as k/64 + 1 limbs of 64 bits. The
+	table is laid out a limb at a time: limb j of the coefficient of x^i is array[j * size + i], so that adding a
+	shifted copy of the table to itself runs straight along contiguous memory, one limb at a time. Working modulo
+	primes instead, the table holds the coefficients modulo each prime in turn, in just the same way. Keeping only
+	half the table, the coefficient of x^i is held at min(i, d - i), where d is the degree of the product.	*/
+typedef struct
+{
+	unsigned long	*oldArray;		/* the coefficients before the last step, limb by limb */
+	unsigned long	*newArray;		/* and after it */
+	unsigned char	*carries;		/* the carry into the next limb of each coefficient */
+	unsigned long	size;			/* the number of coefficients there's room for */
+	unsigned long	numLimbs;		/* and the number of limbs each can have */
+	char			half;			/* do we keep only the first half of the coefficients? */
+	unsigned long	*residues;		/* or, working modulo primes, the coefficients modulo each, prime by prime */
+	unsigned long	*primes;		/* the primes */
+	unsigned long	numPrimes;		/* and how many there are (0 if we're using limbs) */
+	unsigned long	*inverses;		/* inverses[j * numPrimes + i] = 1/p_j modulo p_i, for j < i */
+	unsigned long	*mixed;			/* room for the mixed-radix digits of a coefficient */
+	unsigned long	numThreads;		/* the threads the primes are shared between */
+	pthread_barrier_t	updated, printed;	/* where they wait for each other, and for each line to be written out */
+	pthread_mutex_t	starting;		/* held while the threads are started, so that none begins before the barriers exist */
+	unsigned long	*digits;		/* room to write a coefficient out in decimal */
+	char			*text;
+} TableRec, *TablePtr;
+
+typedef struct
+{
+	TablePtr		table;			/* the table */
+	unsigned long	kval;			/* the largest k */
+	unsigned long	first, last;	/* the primes this thread looks after */
+	char			failed;			/* did it run out of memory? */
+} WorkerRec, *WorkerPtr;
+
+/* a query */
+typedef struct
+{
+	unsigned long	k, m;			/* the coefficient of x^m for k */
+	unsigned long	degree;			/* the power of x with the same coefficient, no more than half way along */
+	char			zero;			/* is m beyond the degree of the product (so the coefficient is zero)? */
+} QueryRec, *QueryPtr;
+
+/* the power series */
+/*	Working modulo a prime p, every number is held in Montgomery form, as x 2^64 mod p, so that we can multiply
+	without dividing by p. Series are multiplied by number-theoretic transforms, which need p - 1 to be divisible
+	by the length of the longest transform.	*/
+typedef struct
+{
+	unsigned long	p;				/* the prime */
+	unsigned long	negInverse;		/* -1/p modulo 2^64 */
+	unsigned long	one, r2;		/* 2^64 and 2^128 modulo p (1 in Montgomery form, and the way to get there) */
+	unsigned long	length;			/* the length of the longest transform */
+	unsigned long	*roots;			/* roots[j] = w^j, for w a root of unity of order length */
+	unsigned long	numTerms;		/* the number of terms in the series */
+	unsigned long	*reciprocals;	/* reciprocals[j] = 1/j */
+	unsigned long	*fa, *fb;		/* room for the transforms */
+	unsigned long	*series;		/* the logarithm of the product */
+	unsigned long	*product, *derivative, *reciprocal, *logarithm, *factor;	/* room for the workings */
+} SeriesRec, *SeriesPtr;
 
 /* function prototypes */
-int						main				( void );
-static unsigned long	doAppInit			( void );
-static char				doAllocateMemory	( unsigned long, double **, double ** );
-static FILE *			doCreateFile		( unsigned long );
-static void				doCalculate			( unsigned long, double *, double *, FILE * );
+int						main				( int, char ** );
+static unsigned long	doAppInit			( char );
+static char				doAllocateMemory	( unsigned long, TablePtr, char, char, unsigned long );
+static void				doFreeMemory		( TablePtr );
+static FILE *			doCreateFile		( unsigned long, char );
+static void				doCalculate			( unsigned long, TablePtr, FILE * );
+static void				doShiftAdd			( TablePtr, unsigned long, unsigned long, unsigned long );
+static void				doFoldAdd			( TablePtr, unsigned long, unsigned long, unsigned long );
+static void				doRunQueries		( void );
+static char				doAddQuery			( QueryPtr *, unsigned long *, unsigned long *, unsigned long, unsigned long );
+static int				doCompareQueries	( const void *, const void * );
+static char *			doFormatCoefficient	( TablePtr, unsigned long, unsigned long );
+static char *			doFormatNumber		( TablePtr, unsigned long );
+static void *			doResidueThread		( void * );
+static void				doUpdateResidues	( TablePtr, unsigned long, unsigned long, unsigned long, unsigned long );
+static char *			doFormatResidues	( TablePtr, unsigned long, unsigned long );
+static void				doFindPrimes		( unsigned long *, unsigned long, unsigned long );
+static char				doIsPrime			( unsigned long );
+static unsigned long	doPowerMod			( unsigned long, unsigned long, unsigned long );
+static void				doCalculateSeries	( unsigned long, TablePtr, FILE * );
+static void *			doSeriesThread		( void * );
+static char				doCheckSeries		( unsigned long, TablePtr );
+static char				doNewSeries			( SeriesPtr, unsigned long, unsigned long );
+static void				doDisposeSeries		( SeriesPtr );
+static void				doSetPrime			( SeriesPtr, unsigned long );
+static unsigned long	doReduce			( SeriesPtr, unsigned __int128 );
+static void				doTransform			( SeriesPtr, unsigned long *, unsigned long, char );
+static void				doMultiplySeries	( SeriesPtr, unsigned long *, unsigned long, unsigned long *, unsigned long, unsigned long *, unsigned long );
+static void				doInvertSeries		( SeriesPtr, unsigned long *, unsigned long *, unsigned long );
+static void				doLogSeries			( SeriesPtr, unsigned long *, unsigned long *, unsigned long );
+static void				doExpSeries			( SeriesPtr, unsigned long *, unsigned long *, unsigned long );
 
 /* main -	the program entry/exit point */
-int main( void )
+int main( int argc, char **argv )
 {
-	unsigned long	kval;
+	unsigned long	kval, numThreads = 1;
+	char			engine = kLimbs, half = kFalse, query = kFalse, usage = kFalse;
+	int				i;
+	
+	/* read the command line */
+	for( i = 1; i < argc; i++ )
+	{
+		if( !strcmp( argv[i], "-modular" ) )
+			engine = kModular;
+		else if( !strcmp( argv[i], "-series" ) )
+			engine = kSeries;
+		else if( !strcmp( argv[i], "-half" ) )
+			half = kTrue;
+		else if( !strcmp( argv[i], "-query" ) )
+			query = kTrue;
+		else if( !strcmp( argv[i], "-threads" ) && (i + 1 < argc) && (atoi( argv[i + 1] ) > 0) )
+			numThreads = atoi( argv[++i] );
+		else
+			usage = kTrue;
+	}
+	if( usage || (half && (engine == kSeries)) || (query && (half || (engine != kLimbs) || (numThreads > 1))) )
+	{
+		printf( "Usage: %s [-modular | -series] [-half] [-threads t] (but not -series with -half)\n", argv[0] );
+		printf( "       %s -query\n", argv[0] );
+		return( 1 );
+	}
+	
+	/* answer the queries (if that's what we've been asked to do) */
+	if( query )
+	{
+		doAppInit( kTrue );
+		doRunQueries();
+		return( 0 );
+	}
 	
 	/* input the range over which to calcuate the coefficients */
-	kval = doAppInit();
+	kval = doAppInit( kFalse );
 	if( kval > 1 )
 	{
-		double		*oldArray, *newArray;
+		TableRec	table;
 		
 		/* allocate the memory */
-		if( doAllocateMemory( kval, &oldArray, &newArray ) )
+		if( doAllocateMemory( kval, &table, engine, half, numThreads ) )
 		{
 			FILE		*file;
 			
 			/* create the LaTeX output file (if requested) */
-			file = doCreateFile( kval );
+			file = doCreateFile( kval, engine == kSeries );
 			
 			/* calculate the coefficients */
-			doCalculate( kval, oldArray, newArray, file );
+			if( engine == kSeries )		doCalculateSeries( kval, &table, file );
+			else						doCalculate( kval, &table, file );
 			
 			/* close the LaTeX output file */
 			if( file )	fclose( file );
 			
 			/* free the memory */
-			free( (void *)oldArray );
-			free( (void *)newArray );
+			doFreeMemory( &table );
 		}
 	}
 }	
 
-/* doAppInit -	call to initialize the application */
-static unsigned long doAppInit( void )
+/* doAppInit -	call to initialize the application (and, unless we're answering queries, find out kval) */
+static unsigned long doAppInit( char query )
 {
 	int	kval;
 	
@@ -66,6 +205,11 @@ static unsigned long doAppInit( void )
 	printf( "%sProgrammed by Alexander M Kasprzyk, Jan 2003.\n\n", kRuleOff );
 	printf( "\thttp://www.math.unb.ca/~kasprzyk/\n\n%s", kRuleOff );
 	printf( "This program lists the coefficients of x^i in the expansion of\n\t(1 + x)(1 + x^2)...(1 + x^k)" );
+	if( query )
+	{
+		printf( "\n\n%sEnter the queries as 'k m' or 'k m1-m2', ending with end of file:\n", kRuleOff );
+		return( 0 );
+	}
 	
 	/* input the range over which to calculate the results */
 	printf( "\n\n%sList coefficients for 1 <= k <= ", kRuleOff );
@@ -74,29 +218,81 @@ static unsigned long doAppInit( void )
 	return( kval );
 }
 
-/* doAllocateMemory -	call to assign the memory needed for the search */
-static char doAllocateMemory( unsigned long kval, double **oldArray, double **newArray )
+/* doAllocateMemory -	call to assign the memory needed for the search (using limbs, or working modulo primes) */
+/*	Every coefficient is less than 2^kval, so kval/61 + 1 primes larger than 2^61 are enough to pin it down. For
+	the power series, the primes must suit transforms twice as long as the first half of the coefficients.	*/
+static char doAllocateMemory( unsigned long kval, TablePtr table, char engine, char half, unsigned long numThreads )
 {
-	unsigned long	deln = kval * (kval + 1) / 2 + 1;
+	char			modular = (engine != kLimbs);
+	unsigned long	order = 2;
 	
-	/* allocate the memory */
-	if( !(*oldArray = (double *)malloc( sizeof( double ) * deln )) )
+	memset( (void *)table, 0, sizeof( TableRec ) );
+	table->size = half ? kval * (kval + 1) / 4 + 1 : kval * (kval + 1) / 2 + 1;
+	table->numLimbs = kval / kLimbBits + 1;
+	table->half = half;
+	
+	/* allocate the memory (the tables start at zero) */
+	if( !modular )
 	{
-		printf( "Not enough memory!\n" );
-		return( kFalse );
+		if( !half )
+			table->oldArray = (unsigned long *)calloc( table->size * table->numLimbs, sizeof( unsigned long ) );
+		table->newArray = (unsigned long *)calloc( table->size * table->numLimbs, sizeof( unsigned long ) );
+		table->carries = (unsigned char *)malloc( table->size );
+	}
+	else
+	{
+		table->numPrimes = kval / kPrimeBits + 1;
+		table->residues = (unsigned long *)calloc( table->size * table->numPrimes, sizeof( unsigned long ) );
+		table->primes = (unsigned long *)malloc( sizeof( unsigned long ) * table->numPrimes );
+		table->inverses = (unsigned long *)malloc( sizeof( unsigned long ) * table->numPrimes * table->numPrimes );
+		table->mixed = (unsigned long *)malloc( sizeof( unsigned long ) * table->numPrimes );
 	}
-	if( !(*newArray = (double *)malloc( sizeof( double ) * deln )) )
+	table->digits = (unsigned long *)malloc( sizeof( unsigned long ) * 2 * (table->numLimbs + 1) );
+	table->text = (char *)malloc( 20 * 2 * (table->numLimbs + 1) + 1 );
+	if( (modular ? (!table->residues || !table->primes || !table->inverses || !table->mixed)
+		: ((!half && !table->oldArray) || !table->newArray || !table->carries)) || !table->digits || !table->text )
 	{
-		free( (void *)(*oldArray) );
+		doFreeMemory( table );
 		printf( "Not enough memory!\n" );
 		return( kFalse );
 	}
 	
+	/* find the primes, and the inverses we need to put the residues back together */
+	if( modular )
+	{
+		unsigned long	i, j;
+		
+		if( engine == kSeries )
+			for( order = 2; order < table->size / 2 + 1; order <<= 1 )
+				;
+		doFindPrimes( table->primes, table->numPrimes, 2 * order );
+		for( i = 0; i < table->numPrimes; i++ )
+			for( j = 0; j < i; j++ )
+				*(table->inverses + j * table->numPrimes + i) = doPowerMod( *(table->primes + j) % *(table->primes + i),
+					*(table->primes + i) - 2, *(table->primes + i) );
+		table->numThreads = (numThreads < table->numPrimes) ? numThreads : table->numPrimes;
+		if( table->numThreads > kMaxThreads )	table->numThreads = kMaxThreads;
+	}
+	
 	return( kTrue );
 }
 
-/* doCreateFile -	call to create the LaTeX output file (if required) */
-static FILE *doCreateFile( unsigned long kval )
+/* doFreeMemory -	call to release the memory */
+static void doFreeMemory( TablePtr table )
+{
+	free( (void *)table->oldArray );
+	free( (void *)table->newArray );
+	free( (void *)table->carries );
+	free( (void *)table->residues );
+	free( (void *)table->primes );
+	free( (void *)table->inverses );
+	free( (void *)table->mixed );
+	free( (void *)table->digits );
+	free( (void *)table->text );
+}
+
+/* doCreateFile -	call to create the LaTeX output file (if required), for every k up to kval or for kval alone */
+static FILE *doCreateFile( unsigned long kval, char onlyLast )
 {
 	char			latex[5];
 	FILE			*file = kFalse;
@@ -113,7 +309,8 @@ static FILE *doCreateFile( unsigned long kval )
 		sprintf( name, "Coeff_%d.tex", kval );
 		if( file = fopen( name, "w" ) )
 		{
-			fprintf( file, "The coefficients of $x^i$ in $\\prod_{i=1}^k(1+x^i)$ for $k=1,\\ldots,%d$.\n", kval );
+			if( onlyLast )	fprintf( file, "The coefficients of $x^i$ in $\\prod_{i=1}^k(1+x^i)$ for $k=%lu$.\n", kval );
+			else			fprintf( file, "The coefficients of $x^i$ in $\\prod_{i=1}^k(1+x^i)$ for $k=1,\\ldots,%d$.\n", kval );
 			fprintf( file, "\\begin{longtable}{|r|p{6in}|}\n\\hline$k$&Coefficients\\\\\n\\hline\\endhead\n" );
 		}
 		else
@@ -126,14 +323,50 @@ static FILE *doCreateFile( unsigned long kval )
 }
 
 /* doCalculate -	call to calculate the coefficients */
-static void doCalculate( unsigned long kval, double *oldArray, double *newArray, FILE *file )
+/*	Working modulo primes, the other threads each update their share of the primes, and then wait while we write
+	the coefficients out. The threads wait for us to let go of the starting lock, so if some of them can't be started,
+	the primes can still be shared out between those that were, and the barriers made for that many.	*/
+static void doCalculate( unsigned long kval, TablePtr table, FILE *file )
 {
-	unsigned long	deln = kval * (kval + 1) / 2 + 1, count;
+	unsigned long	deln, count, i;
+	pthread_t		threads[kMaxThreads];
+	WorkerRec		workers[kMaxThreads];
 	
 	/* set the case of n=1 by hand */
-	for( count = 0; count < deln; count++ )
-		*(newArray + count) = 0;
-	*newArray = *(newArray + 1) = *oldArray = *(oldArray + 1) = 1;
+	if( table->numPrimes )
+	{
+		for( i = 0; i < table->numPrimes; i++ )
+			*(table->residues + i * table->size) = *(table->residues + i * table->size + 1) = 1;
+		pthread_mutex_init( &table->starting, NULL );
+		pthread_mutex_lock( &table->starting );
+		for( i = 0; i < table->numThreads; i++ )
+		{
+			workers[i].table = table;
+			workers[i].kval = kval;
+			if( i && pthread_create( threads + i, NULL, doResidueThread, (void *)(workers + i) ) )
+			{
+				printf( "Unable to start more than %lu threads; continuing on those.\n", i );
+				table->numThreads = i;
+			}
+		}
+		for( i = 0; i < table->numThreads; i++ )
+		{
+			workers[i].first = i * table->numPrimes / table->numThreads;
+			workers[i].last = (i + 1) * table->numPrimes / table->numThreads;
+		}
+		if( table->numThreads > 1 )
+		{
+			pthread_barrier_init( &table->updated, NULL, table->numThreads );
+			pthread_barrier_init( &table->printed, NULL, table->numThreads );
+		}
+		pthread_mutex_unlock( &table->starting );
+	}
+	else
+	{
+		*table->newArray = *(table->newArray + 1) = 1;
+		if( !table->half )
+			*table->oldArray = *(table->oldArray + 1) = 1;
+	}
 	deln = 2;
 	printf( "n =\t1\n1\t1\t" );
 	if( file )	fprintf( file, "1&1,1\\\\\n\\hline\n" );
@@ -141,33 +374,775 @@ static void doCalculate( unsigned long kval, double *oldArray, double *newArray,
 	/* now calculate the remaining cases inductively */
 	for( count = 2; count <= kval; count++ )
 	{
-		unsigned long		counter;
+		unsigned long		counter, numLimbs = count / kLimbBits + 1;
+		char				*text;
 		
 		printf( "\n\nn =\t%d\n", count );
 		if( file )	fprintf( file, "%d&", count );
 		deln += count;
 		
-		printf( "%.0f\t", *newArray );
-		if( file )	fprintf( file, "%.0f", *newArray );
+		/* multiply by (1 + x^count) */
+		if( table->numPrimes )
+		{
+			doUpdateResidues( table, workers[0].first, workers[0].last, count, deln );
+			if( table->numThreads > 1 )		pthread_barrier_wait( &table->updated );
+		}
+		else if( table->half )
+			doFoldAdd( table, count, deln, numLimbs );
+		else
+			doShiftAdd( table, count, deln, numLimbs );
 		
-		for( counter = 1; counter < count; counter++ )
+		for( counter = 0; counter < deln; counter++ )
 		{
-			printf( "%.0f\t", *(newArray + counter) );
-			if( file )	fprintf( file, ", %.0f", *(newArray + counter) );
+			i = (table->half && (2 * counter > deln - 1)) ? deln - 1 - counter : counter;
+			text = table->numPrimes ? doFormatResidues( table, i, numLimbs ) : doFormatCoefficient( table, i, numLimbs );
+			printf( "%s\t", text );
+			if( file )	fprintf( file, counter ? ", %s" : "%s", text );
 		}
-			
+		if( file )	fprintf( file, "\\\\\n\\hline\n" );
+		if( table->numThreads > 1 )		pthread_barrier_wait( &table->printed );
+	}
+	
+	/* wait for the other threads */
+	if( table->numThreads > 1 )
+	{
+		for( i = 1; i < table->numThreads; i++ )
+			pthread_join( threads[i], NULL );
+		pthread_barrier_destroy( &table->updated );
+		pthread_barrier_destroy( &table->printed );
+	}
+	if( table->numPrimes )
+		pthread_mutex_destroy( &table->starting );
+	
+	/* finish off */
+	printf( "\n\n%sFinished.\n", kRuleOff );
+	if( file )	fprintf( file, "\\end{longtable}\n", kval );
+}
+
+/* doShiftAdd -	call to add the coefficients of x^i to those of x^(i + count), for i + count < deln */
+/*	This works through the table a limb at a time, from the lowest, carrying into the next limb as it goes. The
+	previous coefficients are kept in oldArray (so that we only ever read them, and the limbs of each coefficient
+	can be updated independently), which leaves nothing in the loop but adds: the compiler can vectorise it.	*/
+static void doShiftAdd( TablePtr table, unsigned long count, unsigned long deln, unsigned long numLimbs )
+{
+	unsigned long	limb, counter;
+	
+	for( counter = count; counter < deln; counter++ )
+		*(table->carries + counter) = 0;
+	for( limb = 0; limb < numLimbs; limb++ )
+	{
+		unsigned long	*newArray = table->newArray + limb * table->size, *oldArray = table->oldArray + limb * table->size;
+		unsigned char	*carries = table->carries;
+		
 		for( counter = count; counter < deln; counter++ )
 		{
-			*(oldArray + counter) = *(newArray + counter);
-			*(newArray + counter) += *(oldArray + counter - count);
-			printf( "%.0f\t", *(newArray + counter) );
-			if( file )	fprintf( file, ", %.0f", *(newArray + counter) );
+			unsigned long	a = *(newArray + counter), sum = a + *(oldArray + counter - count), total = sum + *(carries + counter);
+			
+			*(oldArray + counter) = a;
+			*(carries + counter) = (sum < a) | (total < sum);
+			*(newArray + counter) = total;
 		}
 		*(oldArray + count) = *(newArray + count);
-		if( file )	fprintf( file, "\\\\\n\\hline\n" );
 	}
+}
+
+/* doFoldAdd -	call to multiply by (1 + x^count) when we keep only the first half of the coefficients */
+/*	The product had degree d = deln - 1 - count, and now has degree deln - 1. Working downwards, we need only the
+	coefficients of x^i for i <= d/2, which haven't been changed yet: beyond that, the coefficient of x^i is that of
+	x^(d - i). There's just the one table, so the limbs of each coefficient are updated in place, lowest first.	*/
+static void doFoldAdd( TablePtr table, unsigned long count, unsigned long deln, unsigned long numLimbs )
+{
+	unsigned long	top = (deln - 1) / 2, last = deln - 1 - count, middle = last / 2, limb, counter;
+	
+	for( counter = 0; counter <= top; counter++ )
+		*(table->carries + counter) = 0;
+	for( limb = 0; limb < numLimbs; limb++ )
+	{
+		unsigned long	*array = table->newArray + limb * table->size;
+		unsigned char	*carries = table->carries;
+		
+		/* the coefficients we didn't have before, */
+		for( counter = top; counter > middle; counter-- )
+		{
+			unsigned long	a = *(array + last - counter), sum = a + ((counter >= count) ? *(array + counter - count) : 0),
+							total = sum + *(carries + counter);
+			
+			*(carries + counter) = (sum < a) | (total < sum);
+			*(array + counter) = total;
+		}
+		
+		/* and the rest */
+		for( counter = middle + 1; counter-- > count; )
+		{
+			unsigned long	a = *(array + counter), sum = a + *(array + counter - count), total = sum + *(carries + counter);
+			
+			*(carries + counter) = (sum < a) | (total < sum);
+			*(array + counter) = total;
+		}
+	}
+}
+
+/* doRunQueries -	call to read the queries, and answer them */
+/*	The coefficient of x^m for k depends only on the factors (1 + x^i) with i <= m, and equals that of x^(d - m),
+	where d = k(k + 1)/2. So, having sorted the queries by k, we multiply out the product just once, keeping only
+	the powers of x up to the largest m we need, and answer each query as we reach its k.	*/
+static void doRunQueries( void )
+{
+	QueryPtr		queries = kFalse;
+	TableRec		table;
+	unsigned long	numQueries = 0, maxQueries = 0, top = 0, maxk = 0, k, m, last, i, count, deln;
+	char			kText[50], range[50];
+	
+	/* read the queries (only digits, and the '-' of a range, are allowed: scanf would take "-5" as a huge number) */
+	while( scanf( "%49s %49s", kText, range ) == 2 )
+	{
+		size_t	digits = strspn( range, "0123456789" );
+		int		parts = 0;
+		
+		if( (strspn( kText, "0123456789" ) == strlen( kText ))
+			&& digits && (!range[digits] || ((range[digits] == '-') && range[digits + 1]
+			&& (strspn( range + digits + 1, "0123456789" ) == strlen( range + digits + 1 )))) )
+		{
+			sscanf( kText, "%lu", &k );
+			parts = sscanf( range, "%lu-%lu", &m, &last );
+		}
+		if( (parts < 1) || !k || ((parts == 2) && (last < m)) )
+		{
+			printf( "Ignoring the query '%s %s'.\n", kText, range );
+			continue;
+		}
+		if( k > kMaxQueryK )
+		{
+			printf( "Ignoring the query '%s %s' (k can be at most %lu).\n", kText, range, kMaxQueryK );
+			continue;
+		}
+		if( parts == 1 )
+			last = m;
+		for( ; m <= last; m++ )
+			if( !doAddQuery( &queries, &numQueries, &maxQueries, k, m ) )
+			{
+				printf( "Not enough memory!\n" );
+				free( (void *)queries );
+				return;
+			}
+	}
+	if( !numQueries )
+		return;
+	
+	/* sort them, and find out how much of the product we need */
+	qsort( (void *)queries, numQueries, sizeof( QueryRec ), doCompareQueries );
+	for( i = 0; i < numQueries; i++ )
+		if( !(queries + i)->zero && ((queries + i)->degree > top) )
+			top = (queries + i)->degree;
+	maxk = (queries + numQueries - 1)->k;
+	
+	/* allocate the memory (each coefficient we keep is less than 2^min(k, top)) */
+	memset( (void *)&table, 0, sizeof( TableRec ) );
+	table.size = top + 2;
+	table.numLimbs = ((maxk < top) ? maxk : top) / kLimbBits + 1;
+	table.oldArray = (unsigned long *)calloc( table.size * table.numLimbs, sizeof( unsigned long ) );
+	table.newArray = (unsigned long *)calloc( table.size * table.numLimbs, sizeof( unsigned long ) );
+	table.carries = (unsigned char *)malloc( table.size );
+	table.digits = (unsigned long *)malloc( sizeof( unsigned long ) * 2 * (table.numLimbs + 1) );
+	table.text = (char *)malloc( 20 * 2 * (table.numLimbs + 1) + 1 );
+	if( !table.oldArray || !table.newArray || !table.carries || !table.digits || !table.text )
+	{
+		printf( "Not enough memory!\n" );
+		doFreeMemory( &table );
+		free( (void *)queries );
+		return;
+	}
+	
+	/* set the case of k=1 by hand, and then multiply out the product as far as each k in turn */
+	*table.newArray = *(table.newArray + 1) = *table.oldArray = *(table.oldArray + 1) = 1;
+	printf( "\n%s", kRuleOff );
+	for( i = 0, count = 1, deln = 2; i < numQueries; i++ )
+	{
+		QueryPtr	q = queries + i;
+		
+		for( ; count < q->k; )
+		{
+			count++;
+			deln += count;
+			if( count <= top )
+				doShiftAdd( &table, count, (deln < top + 1) ? deln : top + 1, count / kLimbBits + 1 );
+		}
+		printf( "k =\t%lu\tm =\t%lu\t%s\n", q->k, q->m, q->zero ? "0"
+			: doFormatCoefficient( &table, q->degree, ((count < top) ? count : top) / kLimbBits + 1 ) );
+	}
+	printf( "\n%sFinished.\n", kRuleOff );
+	
+	doFreeMemory( &table );
+	free( (void *)queries );
+}
+
+/* doAddQuery -	call to add the query (k, m) to the list, making more room for them if need be */
+static char doAddQuery( QueryPtr *queries, unsigned long *numQueries, unsigned long *maxQueries, unsigned long k, unsigned long m )
+{
+	QueryPtr		q;
+	unsigned long	degree = k * (k + 1) / 2;
+	
+	if( *numQueries == *maxQueries )
+	{
+		unsigned long	size = *maxQueries ? 2 * *maxQueries : 64;
+		QueryPtr		more = (QueryPtr)realloc( (void *)*queries, sizeof( QueryRec ) * size );
+		
+		if( !more )
+			return( kFalse );
+		*queries = more;
+		*maxQueries = size;
+	}
+	q = *queries + (*numQueries)++;
+	q->k = k;
+	q->m = m;
+	q->zero = (m > degree);
+	q->degree = q->zero ? 0 : ((2 * m > degree) ? degree - m : m);
+	
+	return( kTrue );
+}
+
+/* doCompareQueries -	call to order the queries by k, and then by m */
+static int doCompareQueries( const void *a, const void *b )
+{
+	QueryPtr	q1 = (QueryPtr)a, q2 = (QueryPtr)b;
+	
+	if( q1->k != q2->k )	return( (q1->k < q2->k) ? -1 : 1 );
+	if( q1->m != q2->m )	return( (q1->m < q2->m) ? -1 : 1 );
+	
+	return( 0 );
+}
+
+/* doFormatCoefficient -	call to write the coefficient of x^i out in decimal (returning the text) */
+static char *doFormatCoefficient( TablePtr table, unsigned long i, unsigned long numLimbs )
+{
+	unsigned long	limb;
+	
+	for( limb = 0; limb < numLimbs; limb++ )
+		*(table->digits + limb) = *(table->newArray + limb * table->size + i);
+	
+	return( doFormatNumber( table, numLimbs ) );
+}
+
+/* doFormatNumber -	call to write out in decimal the number whose limbs are in digits (returning the text) */
+/*	The number is divided repeatedly by 10^19, which leaves its digits 19 at a time, lowest first.	*/
+static char *doFormatNumber( TablePtr table, unsigned long numLimbs )
+{
+	unsigned long	*limbs = table->digits, *chunks = table->digits + numLimbs, numChunks = 0, limb;
+	char			*text = table->text;
+	
+	/* ignore any limbs that are zero at the top */
+	while( numLimbs > 1 && !*(limbs + numLimbs - 1) )
+		numLimbs--;
+	
+	/* divide it into pieces of 19 digits */
+	do
+	{
+		unsigned __int128	rest = 0;
+		
+		for( limb = numLimbs; limb-- > 0; )
+		{
+			rest = (rest << kLimbBits) | *(limbs + limb);
+			*(limbs + limb) = (unsigned long)(rest / kChunk);
+			rest %= kChunk;
+		}
+		*(chunks + numChunks++) = (unsigned long)rest;
+		while( numLimbs > 1 && !*(limbs + numLimbs - 1) )
+			numLimbs--;
+	} while( numLimbs > 1 || *limbs );
+	
+	/* and write them out, highest first */
+	text += sprintf( text, "%lu", *(chunks + --numChunks) );
+	while( numChunks )
+		text += sprintf( text, "%019lu", *(chunks + --numChunks) );
+	
+	return( table->text );
+}
+
+/* doResidueThread -	call to update a thread's share of the primes, for each k in turn */
+static void *doResidueThread( void *worker )
+{
+	WorkerPtr		w = (WorkerPtr)worker;
+	unsigned long	deln = 2, count;
+	
+	/* wait until our share of the primes and the barriers are set up */
+	pthread_mutex_lock( &w->table->starting );
+	pthread_mutex_unlock( &w->table->starting );
+	for( count = 2; count <= w->kval; count++ )
+	{
+		deln += count;
+		doUpdateResidues( w->table, w->first, w->last, count, deln );
+		pthread_barrier_wait( &w->table->updated );
+		pthread_barrier_wait( &w->table->printed );
+	}
+	
+	return( NULL );
+}
+
+/* doUpdateResidues -	call to multiply by (1 + x^count), modulo the primes from first up to (but not including) last */
+/*	Working downwards, x^(i - count) hasn't been changed yet when we add it to x^i, so we need only the one table.
+	Keeping only the first half of the coefficients, those we didn't have before come from the other end (as in
+	doFoldAdd).	*/
+static void doUpdateResidues( TablePtr table, unsigned long first, unsigned long last, unsigned long count, unsigned long deln )
+{
+	unsigned long	degree = deln - 1 - count, top = table->half ? (deln - 1) / 2 : deln - 1, middle = table->half ? degree / 2 : top;
+	unsigned long	j, counter;
+	
+	for( j = first; j < last; j++ )
+	{
+		unsigned long	p = *(table->primes + j), *residues = table->residues + j * table->size;
+		
+		for( counter = top; counter > middle; counter-- )
+		{
+			unsigned long	sum = *(residues + degree - counter) + ((counter >= count) ? *(residues + counter - count) : 0);
+			
+			*(residues + counter) = sum - (p & -(unsigned long)(sum >= p));
+		}
+		for( counter = middle + 1; counter-- > count; )
+		{
+			unsigned long	sum = *(residues + counter) + *(residues + counter - count);
+			
+			*(residues + counter) = sum - (p & -(unsigned long)(sum >= p));
+		}
+	}
+}
+
+/* doFormatResidues -	call to put the coefficient of x^i back together from its residues, and write it out in decimal */
+/*	Garner's algorithm finds the digits v_j with x = v_0 + p_0(v_1 + p_1(v_2 + ...)), 0 <= v_j < p_j, and then we
+	work outwards from the last of them. Only the primes that a coefficient of (1 + x)...(1 + x^k) can need are
+	used; the rest of the digits would be zero.	*/
+static char *doFormatResidues( TablePtr table, unsigned long i, unsigned long numLimbs )
+{
+	unsigned long	*v = table->mixed, numPrimes = (numLimbs * kLimbBits) / kPrimeBits + 1, j, m, limb;
+	
+	if( numPrimes > table->numPrimes )	numPrimes = table->numPrimes;
+	
+	/* the mixed-radix digits */
+	for( j = 0; j < numPrimes; j++ )
+	{
+		unsigned long	p = *(table->primes + j), x = *(table->residues + j * table->size + i);
+		
+		for( m = 0; m < j; m++ )
+			x = (unsigned long)((unsigned __int128)((x + p - *(v + m) % p) % p) * *(table->inverses + m * table->numPrimes + j) % p);
+		*(v + m) = x;
+	}
+	
+	/* and the number itself, x = (...(v_{m-1} p_{m-2} + v_{m-2}) p_{m-3} + ...) p_0 + v_0 */
+	memset( (void *)table->digits, 0, sizeof( unsigned long ) * (numLimbs + 1) );
+	*table->digits = *(v + numPrimes - 1);
+	for( j = numPrimes - 1; j-- > 0; )
+	{
+		unsigned __int128	carry = *(v + j);
+		
+		for( limb = 0; limb <= numLimbs; limb++ )
+		{
+			carry += (unsigned __int128)*(table->digits + limb) * *(table->primes + j);
+			*(table->digits + limb) = (unsigned long)carry;
+			carry >>= kLimbBits;
+		}
+	}
+	
+	return( doFormatNumber( table, numLimbs + 1 ) );
+}
+
+/* doFindPrimes -	call to find the largest primes below 2^62 that are 1 more than a multiple of order (which is even) */
+static void doFindPrimes( unsigned long *primes, unsigned long numPrimes, unsigned long order )
+{
+	unsigned long	q = ((1UL << 62) - 2) / order * order + 1;
+	
+	while( numPrimes )
+	{
+		if( doIsPrime( q ) )
+		{
+			*primes++ = q;
+			numPrimes--;
+		}
+		q -= order;
+	}
+}
+
+/* doIsPrime -	call to check whether n (which is odd, and at least 3) is prime */
+/*	The Miller-Rabin test with these bases makes no mistakes below 2^64.	*/
+static char doIsPrime( unsigned long n )
+{
+	static const unsigned long	bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+	unsigned long				d = n - 1, x, i, r, s = 0;
+	
+	while( !(d & 1) )
+	{
+		d >>= 1;
+		s++;
+	}
+	for( i = 0; i < sizeof( bases ) / sizeof( bases[0] ); i++ )
+	{
+		if( !(bases[i] % n) )
+			continue;
+		if( ((x = doPowerMod( bases[i], d, n )) == 1) || (x == n - 1) )
+			continue;
+		for( r = 1; r < s; r++ )
+			if( (x = (unsigned long)((unsigned __int128)x * x % n)) == n - 1 )
+				break;
+		if( r == s )
+			return( kFalse );
+	}
+	
+	return( kTrue );
+}
+
+/* doPowerMod -	call to calculate a^e modulo p */
+static unsigned long doPowerMod( unsigned long a, unsigned long e, unsigned long p )
+{
+	unsigned long	result = 1 % p;
+	
+	for( a %= p; e; e >>= 1 )
+	{
+		if( e & 1 )		result = (unsigned long)((unsigned __int128)result * a % p);
+		a = (unsigned long)((unsigned __int128)a * a % p);
+	}
+	
+	return( result );
+}
+
+/* doCalculateSeries -	call to calculate the coefficients for k = kval alone, by power series */
+/*	The coefficients are palindromic, so we need only the first half of them. The other threads each find them
+	modulo their share of the primes, and (if kval is small enough) we check them against the recurrence.	*/
+static void doCalculateSeries( unsigned long kval, TablePtr table, FILE *file )
+{
+	unsigned long	counter, i;
+	pthread_t		threads[kMaxThreads];
+	WorkerRec		workers[kMaxThreads];
+	char			failed = kFalse, *text;
+	
+	/* find the coefficients modulo each prime */
+	for( i = 0; i < table->numThreads; i++ )
+	{
+		workers[i].table = table;
+		workers[i].kval = kval;
+		workers[i].first = i * table->numPrimes / table->numThreads;
+		workers[i].last = (i + 1) * table->numPrimes / table->numThreads;
+		workers[i].failed = kFalse;
+		if( i && pthread_create( threads + i, NULL, doSeriesThread, (void *)(workers + i) ) )
+		{
+			workers[0].last = workers[i].last;
+			workers[i].first = workers[i].last;
+		}
+	}
+	doSeriesThread( (void *)workers );
+	for( i = 0; i < table->numThreads; i++ )
+	{
+		if( i && (workers[i].first < workers[i].last) )
+			pthread_join( threads[i], NULL );
+		failed |= workers[i].failed;
+	}
+	if( failed )
+	{
+		printf( "Not enough memory!\n" );
+		return;
+	}
+	
+	/* check them (if we can), and write them out */
+	if( (kval <= kCrossCheck) && !doCheckSeries( kval, table ) )
+	{
+		printf( "Error! The power series and the recurrence don't agree.\n" );
+		return;
+	}
+	printf( "n =\t%lu\n", kval );
+	if( file )	fprintf( file, "%lu&", kval );
+	for( counter = 0; counter < table->size; counter++ )
+	{
+		text = doFormatResidues( table, counter, table->numLimbs );
+		printf( "%s\t", text );
+		if( file )	fprintf( file, counter ? ", %s" : "%s", text );
+	}
+	if( file )	fprintf( file, "\\\\\n\\hline\n" );
 	
 	/* finish off */
 	printf( "\n\n%sFinished.\n", kRuleOff );
-	if( file )	fprintf( file, "\\end{longtable}\n", kval );
+	if( file )	fprintf( file, "\\end{longtable}\n" );
+}
+
+/* doSeriesThread -	call to find the coefficients modulo a thread's share of the primes */
+/*	\log\prod_{i=1}^k(1 + x^i) = \sum_{i=1}^k\sum_{j\ge 1}(-1)^{j+1}x^{ij}/j, which we exponentiate.	*/
+static void *doSeriesThread( void *worker )
+{
+	WorkerPtr		w = (WorkerPtr)worker;
+	TablePtr		table = w->table;
+	SeriesRec		series;
+	unsigned long	n = table->size / 2 + 1, length, prime, i, j;
+	
+	for( length = 2; length < n; length <<= 1 )
+		;
+	if( (w->first < w->last) && !doNewSeries( &series, n, 2 * length ) )
+	{
+		w->failed = kTrue;
+		return( NULL );
+	}
+	for( prime = w->first; prime < w->last; prime++ )
+	{
+		unsigned long	*residues = table->residues + prime * table->size, p = *(table->primes + prime);
+		
+		/* the logarithm */
+		doSetPrime( &series, p );
+		for( i = 0; i < n; i++ )
+			*(series.series + i) = 0;
+		for( i = 1; i <= w->kval; i++ )
+			for( j = 1; i * j < n; j++ )
+			{
+				unsigned long	*term = series.series + i * j, r = *(series.reciprocals + j);
+				
+				if( j & 1 )		*term = (*term + r >= p) ? *term + r - p : *term + r;
+				else			*term = (*term >= r) ? *term - r : *term + p - r;
+			}
+		
+		/* its exponential, back out of Montgomery form (and the second half of the coefficients, by symmetry) */
+		doExpSeries( &series, series.series, residues, n );
+		for( i = 0; i < n; i++ )
+			*(residues + i) = doReduce( &series, *(residues + i) );
+		for( i = n; i < table->size; i++ )
+			*(residues + i) = *(residues + table->size - 1 - i);
+	}
+	if( w->first < w->last )
+		doDisposeSeries( &series );
+	
+	return( NULL );
+}
+
+/* doCheckSeries -	call to check the coefficients found by power series against the recurrence */
+static char doCheckSeries( unsigned long kval, TablePtr table )
+{
+	unsigned long	*check, j, count, counter, deln;
+	
+	if( !(check = (unsigned long *)malloc( sizeof( unsigned long ) * table->size )) )
+		return( kFalse );
+	for( j = 0; j < table->numPrimes; j++ )
+	{
+		unsigned long	p = *(table->primes + j);
+		
+		for( counter = 0; counter < table->size; counter++ )
+			*(check + counter) = (counter < 2);
+		for( count = 2, deln = 2; count <= kval; count++ )
+		{
+			deln += count;
+			for( counter = deln; counter-- > count; )
+			{
+				unsigned long	sum = *(check + counter) + *(check + counter - count);
+				
+				*(check + counter) = sum - (p & -(unsigned long)(sum >= p));
+			}
+		}
+		if( memcmp( (void *)check, (void *)(table->residues + j * table->size), sizeof( unsigned long ) * table->size ) )
+		{
+			free( (void *)check );
+			return( kFalse );
+		}
+	}
+	free( (void *)check );
+	
+	return( kTrue );
+}
+
+/* doNewSeries -	call to allocate the room for power series of n terms, and transforms up to the given length */
+static char doNewSeries( SeriesPtr s, unsigned long n, unsigned long length )
+{
+	memset( (void *)s, 0, sizeof( SeriesRec ) );
+	s->numTerms = n;
+	s->length = length;
+	if( !(s->roots = (unsigned long *)malloc( sizeof( unsigned long ) * length / 2 ))
+		|| !(s->reciprocals = (unsigned long *)malloc( sizeof( unsigned long ) * n ))
+		|| !(s->fa = (unsigned long *)malloc( sizeof( unsigned long ) * length ))
+		|| !(s->fb = (unsigned long *)malloc( sizeof( unsigned long ) * length ))
+		|| !(s->series = (unsigned long *)malloc( sizeof( unsigned long ) * n ))
+		|| !(s->product = (unsigned long *)malloc( sizeof( unsigned long ) * n ))
+		|| !(s->derivative = (unsigned long *)malloc( sizeof( unsigned long ) * n ))
+		|| !(s->reciprocal = (unsigned long *)malloc( sizeof( unsigned long ) * n ))
+		|| !(s->logarithm = (unsigned long *)malloc( sizeof( unsigned long ) * n ))
+		|| !(s->factor = (unsigned long *)malloc( sizeof( unsigned long ) * n )) )
+	{
+		doDisposeSeries( s );
+		return( kFalse );
+	}
+	
+	return( kTrue );
+}
+
+/* doDisposeSeries -	call to release the memory of the power series */
+static void doDisposeSeries( SeriesPtr s )
+{
+	free( (void *)s->roots );
+	free( (void *)s->reciprocals );
+	free( (void *)s->fa );
+	free( (void *)s->fb );
+	free( (void *)s->series );
+	free( (void *)s->product );
+	free( (void *)s->derivative );
+	free( (void *)s->reciprocal );
+	free( (void *)s->logarithm );
+	free( (void *)s->factor );
+}
+
+/* doSetPrime -	call to work modulo the prime p (for which p - 1 is divisible by the length of the longest transform) */
+static void doSetPrime( SeriesPtr s, unsigned long p )
+{
+	unsigned long	inverse = p, w, a, j;
+	
+	/* the constants for Montgomery form (each step of Newton's method doubles the bits of 1/p we have right) */
+	s->p = p;
+	for( j = 0; j < 5; j++ )
+		inverse *= 2 - p * inverse;
+	s->negInverse = -inverse;
+	s->one = (unsigned long)(((unsigned __int128)1 << 64) % p);
+	s->r2 = (unsigned long)((unsigned __int128)s->one * s->one % p);
+	
+	/* a root of unity of order length (w^(length/2) must be -1) */
+	for( a = 2; ; a++ )
+		if( doPowerMod( w = doPowerMod( a, (p - 1) / s->length, p ), s->length / 2, p ) == p - 1 )
+			break;
+	w = doReduce( s, (unsigned __int128)w * s->r2 );
+	*s->roots = s->one;
+	for( j = 1; j < s->length / 2; j++ )
+		*(s->roots + j) = doReduce( s, (unsigned __int128)*(s->roots + j - 1) * w );
+	
+	/* and the reciprocals, 1/j = -(p/j)/(p mod j) */
+	*(s->reciprocals + 1) = s->one;
+	for( j = 2; j < s->numTerms; j++ )
+		*(s->reciprocals + j) = doReduce( s, (unsigned __int128)doReduce( s, (unsigned __int128)(p - p / j) * s->r2 )
+			* *(s->reciprocals + p % j) );
+}
+
+/* doReduce -	call to divide t by 2^64 modulo p (for t < 2^64 p), which brings a product back to Montgomery form */
+static unsigned long doReduce( SeriesPtr s, unsigned __int128 t )
+{
+	unsigned long	q = (unsigned long)t * s->negInverse, r = (unsigned long)((t + (unsigned __int128)q * s->p) >> 64);
+	
+	return( (r >= s->p) ? r - s->p : r );
+}
+
+/* doTransform -	call to transform the n numbers in a (n a power of 2), or to transform them back */
+/*	The transform back is the transform, taken in the opposite order and divided by n.	*/
+static void doTransform( SeriesPtr s, unsigned long *a, unsigned long n, char inverse )
+{
+	unsigned long	p = s->p, i, j, bit, len, t;
+	
+	/* put the numbers in bit-reversed order */
+	for( i = 1, j = 0; i < n; i++ )
+	{
+		for( bit = n >> 1; j & bit; bit >>= 1 )
+			j ^= bit;
+		j ^= bit;
+		if( i < j )
+		{
+			t = *(a + i);
+			*(a + i) = *(a + j);
+			*(a + j) = t;
+		}
+	}
+	
+	/* and combine them in pairs, then fours, and so on */
+	for( len = 2; len <= n; len <<= 1 )
+	{
+		unsigned long	half = len / 2, step = s->length / len;
+		
+		for( i = 0; i < n; i += len )
+			for( j = 0; j < half; j++ )
+			{
+				unsigned long	u = *(a + i + j), v = doReduce( s, (unsigned __int128)*(a + i + j + half) * *(s->roots + j * step) );
+				
+				*(a + i + j) = (u + v >= p) ? u + v - p : u + v;
+				*(a + i + j + half) = (u >= v) ? u - v : u + p - v;
+			}
+	}
+	
+	if( inverse )
+	{
+		unsigned long	scale = doReduce( s, (unsigned __int128)doPowerMod( n, p - 2, p ) * s->r2 );
+		
+		for( i = 1, j = n - 1; i < j; i++, j-- )
+		{
+			t = *(a + i);
+			*(a + i) = *(a + j);
+			*(a + j) = t;
+		}
+		for( i = 0; i < n; i++ )
+			*(a + i) = doReduce( s, (unsigned __int128)*(a + i) * scale );
+	}
+}
+
+/* doMultiplySeries -	call to find the first n terms of x y, where x and y have nx and ny terms (out may be x or y) */
+static void doMultiplySeries( SeriesPtr s, unsigned long *x, unsigned long nx, unsigned long *y, unsigned long ny,
+	unsigned long *out, unsigned long n )
+{
+	unsigned long	len, i;
+	
+	if( nx > n )	nx = n;
+	if( ny > n )	ny = n;
+	for( len = 1; len < nx + ny - 1; len <<= 1 )
+		;
+	memcpy( (void *)s->fa, (void *)x, sizeof( unsigned long ) * nx );
+	memset( (void *)(s->fa + nx), 0, sizeof( unsigned long ) * (len - nx) );
+	memcpy( (void *)s->fb, (void *)y, sizeof( unsigned long ) * ny );
+	memset( (void *)(s->fb + ny), 0, sizeof( unsigned long ) * (len - ny) );
+	doTransform( s, s->fa, len, kFalse );
+	doTransform( s, s->fb, len, kFalse );
+	for( i = 0; i < len; i++ )
+		*(s->fa + i) = doReduce( s, (unsigned __int128)*(s->fa + i) * *(s->fb + i) );
+	doTransform( s, s->fa, len, kTrue );
+	for( i = 0; i < n; i++ )
+		*(out + i) = (i < nx + ny - 1) ? *(s->fa + i) : 0;
+}
+
+/* doInvertSeries -	call to find the first n terms of 1/g (where g starts with 1) */
+/*	Newton's method: if f = 1/g to k terms, then f(2 - g f) = 1/g to 2k terms.	*/
+static void doInvertSeries( SeriesPtr s, unsigned long *g, unsigned long *out, unsigned long n )
+{
+	unsigned long	p = s->p, two = (2 * s->one) % p, cur, next, i;
+	
+	*out = s->one;
+	for( cur = 1; cur < n; cur = next )
+	{
+		next = (2 * cur < n) ? 2 * cur : n;
+		doMultiplySeries( s, g, next, out, cur, s->product, next );
+		for( i = 0; i < next; i++ )
+			*(s->product + i) = *(s->product + i) ? p - *(s->product + i) : 0;
+		*s->product = (*s->product + two >= p) ? *s->product + two - p : *s->product + two;
+		doMultiplySeries( s, out, cur, s->product, next, out, next );
+	}
+}
+
+/* doLogSeries -	call to find the first n terms of log g (where g starts with 1), the integral of g'/g */
+static void doLogSeries( SeriesPtr s, unsigned long *g, unsigned long *out, unsigned long n )
+{
+	unsigned long	p = s->p, j = 0, i;
+	
+	*out = 0;
+	if( n < 2 )
+		return;
+	for( i = 0; i < n - 1; i++ )
+	{
+		j = (j + s->one >= p) ? j + s->one - p : j + s->one;
+		*(s->derivative + i) = doReduce( s, (unsigned __int128)*(g + i + 1) * j );
+	}
+	doInvertSeries( s, g, s->reciprocal, n - 1 );
+	doMultiplySeries( s, s->derivative, n - 1, s->reciprocal, n - 1, out, n - 1 );
+	for( i = n - 1; i > 0; i-- )
+		*(out + i) = doReduce( s, (unsigned __int128)*(out + i - 1) * *(s->reciprocals + i) );
+	*out = 0;
+}
+
+/* doExpSeries -	call to find the first n terms of exp f (where f starts with 0) */
+/*	Newton's method again: if g = exp f to k terms, then g(1 - log g + f) = exp f to 2k terms.	*/
+static void doExpSeries( SeriesPtr s, unsigned long *f, unsigned long *out, unsigned long n )
+{
+	unsigned long	p = s->p, cur, next, i;
+	
+	*out = s->one;
+	for( cur = 1; cur < n; cur = next )
+	{
+		next = (2 * cur < n) ? 2 * cur : n;
+		for( i = cur; i < next; i++ )
+			*(out + i) = 0;
+		doLogSeries( s, out, s->logarithm, next );
+		for( i = 0; i < next; i++ )
+			*(s->factor + i) = (*(f + i) >= *(s->logarithm + i)) ? *(f + i) - *(s->logarithm + i) : *(f + i) + p - *(s->logarithm + i);
+		*s->factor = (*s->factor + s->one >= p) ? *s->factor + s->one - p : *s->factor + s->one;
+		doMultiplySeries( s, out, cur, s->factor, next, out, next );
+	}
 }